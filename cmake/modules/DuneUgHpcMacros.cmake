@@ -1 +1,27 @@
 # File for module specific CMake tests.
+#
+# Modules depending on dune-ug-hpc include this file automatically.  The headers in dune/ug_hpc need ParMETIS
+# and a thread library, PT-Scotch and Zoltan are used if they are found:
+#
+#   add_executable(solver solver.cc)
+#   add_dune_ug_hpc_flags(solver)
+
+find_package(ParMETIS)
+include(AddParMETISFlags)
+
+find_package(Threads)
+
+find_package(PTScotch)
+find_package(Zoltan)
+
+# adds the flags and libraries of the dune-ug-hpc headers to the targets
+function(add_dune_ug_hpc_flags)
+  add_dune_mpi_flags(${ARGN})
+  add_dune_parmetis_flags(${ARGN})
+  add_dune_ptscotch_flags(${ARGN})
+  add_dune_zoltan_flags(${ARGN})
+
+  foreach(_target ${ARGN})
+    target_link_libraries(${_target} ${CMAKE_THREAD_LIBS_INIT})
+  endforeach()
+endfunction()
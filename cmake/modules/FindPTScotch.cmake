@@ -0,0 +1,48 @@
+# Module that checks whether PT-Scotch is available.
+#
+# Accepts the following variables:
+#
+# PTSCOTCH_ROOT: Prefix where PT-Scotch is installed.
+#
+# Sets the following variables:
+#
+# PTSCOTCH_FOUND: True if PT-Scotch was found.
+# PTSCOTCH_INCLUDE_DIRS: Include directories for PT-Scotch.
+# PTSCOTCH_LIBRARIES: Libraries to link against, including libscotch and libscotcherr.
+
+find_path(PTSCOTCH_INCLUDE_DIR ptscotch.h
+  PATHS ${PTSCOTCH_ROOT}
+  PATH_SUFFIXES include include/scotch
+  DOC "Include directory of PT-Scotch")
+
+find_library(PTSCOTCH_LIBRARY ptscotch
+  PATHS ${PTSCOTCH_ROOT}
+  PATH_SUFFIXES lib lib64)
+find_library(PTSCOTCHERR_LIBRARY ptscotcherr
+  PATHS ${PTSCOTCH_ROOT}
+  PATH_SUFFIXES lib lib64)
+find_library(SCOTCH_LIBRARY scotch
+  PATHS ${PTSCOTCH_ROOT}
+  PATH_SUFFIXES lib lib64)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(PTScotch DEFAULT_MSG
+  PTSCOTCH_INCLUDE_DIR PTSCOTCH_LIBRARY PTSCOTCHERR_LIBRARY SCOTCH_LIBRARY)
+
+mark_as_advanced(PTSCOTCH_INCLUDE_DIR PTSCOTCH_LIBRARY PTSCOTCHERR_LIBRARY SCOTCH_LIBRARY)
+
+if(PTSCOTCH_FOUND)
+  set(PTSCOTCH_INCLUDE_DIRS ${PTSCOTCH_INCLUDE_DIR})
+  set(PTSCOTCH_LIBRARIES ${PTSCOTCH_LIBRARY} ${PTSCOTCHERR_LIBRARY} ${SCOTCH_LIBRARY})
+endif()
+
+# adds PT-Scotch flags to the targets
+function(add_dune_ptscotch_flags)
+  if(PTSCOTCH_FOUND)
+    include_directories(${PTSCOTCH_INCLUDE_DIRS})
+    foreach(_target ${ARGN})
+      set_property(TARGET ${_target} APPEND PROPERTY COMPILE_DEFINITIONS HAVE_PTSCOTCH=1)
+      target_link_libraries(${_target} ${PTSCOTCH_LIBRARIES})
+    endforeach()
+  endif()
+endfunction()
@@ -0,0 +1,41 @@
+# Module that checks whether Zoltan is available.
+#
+# Accepts the following variables:
+#
+# ZOLTAN_ROOT: Prefix where Zoltan is installed.
+#
+# Sets the following variables:
+#
+# ZOLTAN_FOUND: True if Zoltan was found.
+# ZOLTAN_INCLUDE_DIRS: Include directories for Zoltan.
+# ZOLTAN_LIBRARIES: Libraries to link against.
+
+find_path(ZOLTAN_INCLUDE_DIR zoltan.h
+  PATHS ${ZOLTAN_ROOT}
+  PATH_SUFFIXES include
+  DOC "Include directory of Zoltan")
+
+find_library(ZOLTAN_LIBRARY zoltan
+  PATHS ${ZOLTAN_ROOT}
+  PATH_SUFFIXES lib lib64)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(Zoltan DEFAULT_MSG ZOLTAN_INCLUDE_DIR ZOLTAN_LIBRARY)
+
+mark_as_advanced(ZOLTAN_INCLUDE_DIR ZOLTAN_LIBRARY)
+
+if(ZOLTAN_FOUND)
+  set(ZOLTAN_INCLUDE_DIRS ${ZOLTAN_INCLUDE_DIR})
+  set(ZOLTAN_LIBRARIES ${ZOLTAN_LIBRARY})
+endif()
+
+# adds Zoltan flags to the targets
+function(add_dune_zoltan_flags)
+  if(ZOLTAN_FOUND)
+    include_directories(${ZOLTAN_INCLUDE_DIRS})
+    foreach(_target ${ARGN})
+      set_property(TARGET ${_target} APPEND PROPERTY COMPILE_DEFINITIONS HAVE_ZOLTAN=1)
+      target_link_libraries(${_target} ${ZOLTAN_LIBRARIES})
+    endforeach()
+  endif()
+endfunction()
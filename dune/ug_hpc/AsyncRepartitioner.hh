@@ -0,0 +1,191 @@
+#ifndef ASYNCREPARTITIONER_H
+#define ASYNCREPARTITIONER_H
+
+#include <dune/common/parallel/mpihelper.hh>
+#include <dune/common/exceptions.hh>
+
+#include <map>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <mpi.h>
+#include <parmetis.h>
+
+#include <dune/ug_hpc/GlobalUniqueIndex.hh>
+#include <dune/ug_hpc/Parmetisgridpartitioner.hh>
+#include <dune/ug_hpc/PartitionConstraints.hh>
+
+
+// Takes partitioning off the critical path: start() snapshots the dual graph of the current leaf grid and runs
+// ParMETIS on it in a helper thread, on a duplicate of the communicator, while the caller continues adapting the
+// grid.  finish() waits for the result and maps it to the leaf grid at that time: every leaf element takes the part
+// of the nearest element of the snapshot on its ancestor chain (or of a snapshot element it is the ancestor of),
+// elements without such a relative stay on their rank.
+//
+// The main thread keeps communicating while ParMETIS runs, so this needs MPI_THREAD_MULTIPLE, see supported().
+template<class GridView>
+class AsyncRepartitioner {
+public:
+#if PARMETIS_MAJOR_VERSION < 4
+  typedef idxtype idx_t;
+  typedef float real_t;
+#endif
+
+  typedef typename GridView::template Codim<0>::template Partition<Dune::Interior_Partition>::Iterator InteriorElementIterator;
+  typedef typename GridView::template Codim<0>::EntityPointer                                          ElementPointer;
+
+  typedef typename GridView::Grid::GlobalIdSet         GlobalIdSet;
+  typedef typename GridView::Grid::GlobalIdSet::IdType IdType;
+
+  typedef ParMetisGridPartitioner<GridView> Partitioner;
+
+
+  // The constraints are referenced and evaluated when the snapshot is taken
+  AsyncRepartitioner(const PartitionConstraints<GridView>& constraints, real_t itr = 1000) :
+    constraints_(constraints), itr_(itr), pending_(false), status_(0)
+  {
+    MPI_Comm_dup(Dune::MPIHelper::getCommunicator(), &comm_);
+  }
+
+  ~AsyncRepartitioner() {
+    if (worker_.joinable())
+      worker_.join();
+
+    MPI_Comm_free(&comm_);
+  }
+
+  // True if MPI was initialized with full thread support
+  static bool supported() {
+    int provided;
+    MPI_Query_thread(&provided);
+
+    return provided == MPI_THREAD_MULTIPLE;
+  }
+
+  bool pending() const {
+    return pending_;
+  }
+
+  void setItr(real_t itr) {
+    itr_ = itr;
+  }
+
+  // Collective: snapshot the dual graph and start partitioning it in the background
+  void start(const GridView& gv) {
+    if (pending_)
+      DUNE_THROW(Dune::InvalidStateException, "A repartition is still running.");
+
+    GlobalUniqueIndex<GridView> globalIndex(gv);
+
+    const std::vector<int>& offset = globalIndex.indexOffset();
+    vtxdist_.assign(offset.begin(), offset.end());
+
+    Partitioner::buildGraph(gv, globalIndex, constraints_, xadj_, adjncy_, vwgt_);
+
+    // Remember the ids of the snapshot elements and their ancestors to map the result to a later grid
+    const GlobalIdSet& globalIdSet = gv.grid().globalIdSet();
+
+    ids_.clear();
+    ancestors_.clear();
+
+    for (InteriorElementIterator eIt = gv.template begin<0, Dune::Interior_Partition>(); eIt != gv.template end<0, Dune::Interior_Partition>(); ++eIt) {
+      const size_t i = ids_.size();
+      ids_.push_back(globalIdSet.id(*eIt));
+
+      for (ElementPointer father(*eIt); father->level() > 0; ) {
+	father = father->father();
+	ancestors_.insert(std::make_pair(globalIdSet.id(*father), i));
+      }
+    }
+
+    part_.assign(ids_.size(), 0);
+    wgtflag_ = constraints_.weighted() ? 2 : 0;
+    ncon_ = constraints_.ncon();
+    nparts_ = gv.comm().size();
+    tpwgts_ = constraints_.tpwgts(nparts_);
+    ubvec_ = constraints_.ubvec();
+
+    pending_ = true;
+    worker_ = std::thread(&AsyncRepartitioner::partition, this);
+  }
+
+  // Collective: wait for the running repartition and return the part vector for the current leaf grid
+  std::vector<unsigned> finish(const GridView& gv) {
+    if (!pending_)
+      DUNE_THROW(Dune::InvalidStateException, "No repartition is running.");
+
+    worker_.join();
+    pending_ = false;
+
+#if PARMETIS_MAJOR_VERSION >= 4
+    if (status_ != METIS_OK)
+      DUNE_THROW(Dune::Exception, "ParMETIS is not happy.");
+#endif
+
+    std::map<IdType, unsigned> partOfId;
+    for (size_t i = 0; i < ids_.size(); ++i)
+      partOfId[ids_[i]] = part_[i];
+    for (typename std::map<IdType, size_t>::const_iterator it = ancestors_.begin(); it != ancestors_.end(); ++it)
+      partOfId.insert(std::make_pair(it->first, part_[it->second]));
+
+    const GlobalIdSet& globalIdSet = gv.grid().globalIdSet();
+    const unsigned rank = gv.comm().rank();
+
+    std::vector<unsigned> interiorPart;
+    for (InteriorElementIterator eIt = gv.template begin<0, Dune::Interior_Partition>(); eIt != gv.template end<0, Dune::Interior_Partition>(); ++eIt) {
+      unsigned target = rank;
+
+      for (ElementPointer element(*eIt); ; element = element->father()) {
+	const typename std::map<IdType, unsigned>::const_iterator it = partOfId.find(globalIdSet.id(*element));
+	if (it != partOfId.end()) {
+	  target = it->second;
+	  break;
+	}
+
+	if (element->level() == 0)
+	  break;
+      }
+
+      interiorPart.push_back(target);
+    }
+
+    return Partitioner::elementPart(gv, interiorPart);
+  }
+
+private:
+  // Runs in the helper thread and only touches the snapshot
+  void partition() {
+    idx_t numflag = 0;
+    idx_t options[4] = {0, 0, 0, 0};
+    idx_t edgecut;
+
+#if PARMETIS_MAJOR_VERSION >= 4
+    status_ =
+#endif
+      ParMETIS_V3_AdaptiveRepart(vtxdist_.data(), xadj_.data(), adjncy_.data(), vwgt_.empty() ? NULL : vwgt_.data(), NULL, NULL,
+				 &wgtflag_, &numflag, &ncon_, &nparts_, tpwgts_.data(), ubvec_.data(),
+				 &itr_, options, &edgecut, part_.data(), &comm_);
+  }
+
+  // Owns a thread and a communicator
+  AsyncRepartitioner(const AsyncRepartitioner&);
+  AsyncRepartitioner& operator=(const AsyncRepartitioner&);
+
+  const PartitionConstraints<GridView>& constraints_;
+  real_t itr_;
+
+  MPI_Comm comm_;
+  std::thread worker_;
+  bool pending_;
+  int status_;
+
+  // Snapshot
+  std::vector<idx_t> vtxdist_, xadj_, adjncy_, vwgt_, part_;
+  idx_t wgtflag_, ncon_, nparts_;
+  std::vector<real_t> tpwgts_, ubvec_;
+  std::vector<IdType> ids_;
+  std::map<IdType, size_t> ancestors_;
+};
+
+#endif
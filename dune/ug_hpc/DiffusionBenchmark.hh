@@ -0,0 +1,210 @@
+#ifndef DIFFUSIONBENCHMARK_H
+#define DIFFUSIONBENCHMARK_H
+
+#include <dune/common/fvector.hh>
+#include <dune/grid/common/mcmgmapper.hh>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <mpi.h>
+
+#include <dune/ug_hpc/HaloExchange.hh>
+#include <dune/ug_hpc/SpaceFillingCurveOrdering.hh>
+
+
+// Solver-like workload on the current partition: explicit cell-centered finite volume diffusion steps on the
+// leaf elements, each followed by a halo exchange that updates the ghost elements with the given method of
+// HaloExchange, gv.communicate by default.  The two-point flux stencil and the exchange lists are set up once
+// per grid, so an iteration is one sweep over the interior elements, which scales with the number of interior
+// elements, plus one exchange, which scales with the partition boundary.  Comparing both times over the ranks
+// shows how well a partition serves a computation.
+template<class GridView>
+class DiffusionBenchmark {
+public:
+  typedef typename GridView::template Codim<0>::Iterator                                               ElementIterator;
+  typedef typename GridView::template Codim<0>::template Partition<Dune::Interior_Partition>::Iterator InteriorElementIterator;
+  typedef typename GridView::template Codim<0>::Entity                                                 Element;
+  typedef typename GridView::IntersectionIterator                                                      IntersectionIterator;
+
+  enum {
+    dimension = GridView::dimension
+  };
+
+  typedef Dune::MultipleCodimMultipleGeomTypeMapper<GridView, Dune::MCMGElementLayout> ElementMapper;
+
+  typedef typename HaloExchange<GridView>::Method ExchangeMethod;
+
+  // Times of one call to run() on this rank, in seconds
+  struct Timings {
+    int iterations;
+    int elements;         // interior elements updated per iteration
+    double compute;       // sweeps over the interior elements
+    double communication; // halo exchanges
+
+    double communicationPerIteration() const {
+      return (iterations > 0) ? communication / iterations : 0;
+    }
+  };
+
+  // Collective: sets up the stencil and the halo exchange of the current grid; with an up-to-date ordering,
+  // the interior elements are swept in curve order
+  explicit DiffusionBenchmark(const GridView& gv, const SpaceFillingCurveOrdering<GridView>* ordering = NULL,
+			      ExchangeMethod exchange = HaloExchange<GridView>::Communicate) :
+    gv_(gv), elementMapper_(gv_), halo_(gv_, exchange)
+  {
+    if (ordering) {
+      const std::vector<typename SpaceFillingCurveOrdering<GridView>::ElementSeed>& elements = ordering->elements();
+      for (size_t i = 0; i < elements.size(); ++i)
+	addRow(*gv_.grid().entityPointer(elements[i]));
+    }
+    else
+      for (InteriorElementIterator eIt = gv_.template begin<0, Dune::Interior_Partition>(); eIt != gv_.template end<0, Dune::Interior_Partition>(); ++eIt)
+	addRow(*eIt);
+
+    rowStart_.push_back(neighbors_.size());
+
+    // Initial state: a ramp in the first coordinate, so that the iterations actually diffuse something
+    u_.assign(elementMapper_.size(), 0);
+    for (ElementIterator eIt = gv_.template begin<0>(); eIt != gv_.template end<0>(); ++eIt)
+      u_[elementMapper_.map(*eIt)] = eIt->geometry().center()[0];
+
+    next_ = u_;
+  }
+
+  // Collective: runs the given number of diffusion steps
+  Timings run(int iterations) {
+    Timings timings;
+    timings.iterations = iterations;
+    timings.elements = rows_.size();
+    timings.compute = timings.communication = 0;
+
+    for (int k = 0; k < iterations; ++k) {
+      double t = MPI_Wtime();
+
+      // Jacobi-type update with the stable local time step 1/(2*diagonal)
+      for (size_t i = 0; i < rows_.size(); ++i) {
+	const int row = rows_[i];
+	const double ui = u_[row];
+
+	double flux = 0;
+	for (int j = rowStart_[i]; j < rowStart_[i+1]; ++j)
+	  flux += coefficients_[j] * (u_[neighbors_[j]] - ui);
+
+	next_[row] = ui + 0.5 * flux / diagonal_[i];
+      }
+
+      for (size_t i = 0; i < rows_.size(); ++i)
+	u_[rows_[i]] = next_[rows_[i]];
+
+      timings.compute += MPI_Wtime() - t;
+
+      t = MPI_Wtime();
+      halo_.exchange(u_);
+      timings.communication += MPI_Wtime() - t;
+    }
+
+    return timings;
+  }
+
+  // Sum of the interior values, the same on any partition of the same grid (collective)
+  double checksum() const {
+    double sum = 0;
+    for (size_t i = 0; i < rows_.size(); ++i)
+      sum += u_[rows_[i]];
+
+    return gv_.comm().sum(sum);
+  }
+
+  // Collective: prints the min / avg / max compute and communication times over the ranks, and the time of
+  // every rank if perRank is set
+  template<class CollectiveCommunication>
+  static void report(const CollectiveCommunication& comm, const Timings& timings, bool perRank = false,
+		     std::ostream& out = std::cout) {
+    const int size = comm.size();
+
+    double local[3] = {timings.compute, timings.communication, double(timings.elements)};
+    std::vector<double> all(3*size);
+    comm.template allgather<double>(local, 3, all.data());
+
+    if (0 != comm.rank())
+      return;
+
+    out << "Benchmark of " << timings.iterations << " diffusion steps in s (min / avg / max over ranks):" << std::endl;
+
+    const char* names[2] = {"compute", "communication"};
+    double slowest = 0, elements = 0;
+
+    for (int j = 0; j < 2; ++j) {
+      double minTime = all[j], maxTime = all[j], sumTime = 0;
+      int maxRank = 0;
+
+      for (int p = 0; p < size; ++p) {
+	const double t = all[3*p + j];
+
+	sumTime += t;
+	minTime = std::min(minTime, t);
+	if (t > maxTime) {
+	  maxTime = t;
+	  maxRank = p;
+	}
+      }
+
+      out << "   " << std::left << std::setw(16) << names[j] << std::right << std::scientific << std::setprecision(3)
+	  << minTime << " / " << sumTime/size << " / " << maxTime << " (rank " << maxRank << ")" << std::endl;
+    }
+
+    for (int p = 0; p < size; ++p) {
+      slowest = std::max(slowest, all[3*p] + all[3*p+1]);
+      elements += all[3*p+2];
+    }
+
+    if (slowest > 0)
+      out << "   throughput       " << elements * timings.iterations / slowest << " element updates/s" << std::endl;
+
+    if (perRank)
+      for (int p = 0; p < size; ++p)
+	out << "   rank " << std::setw(5) << p << "  elements " << std::setw(8) << int(all[3*p+2])
+	    << "  compute " << all[3*p] << "  communication " << all[3*p+1] << std::endl;
+
+    out.unsetf(std::ios::floatfield);
+  }
+
+private:
+  // Two-point flux coefficients |face| / |distance of the centers| towards all neighbors of element
+  void addRow(const Element& element) {
+    const Dune::FieldVector<double, dimension> center = element.geometry().center();
+
+    rows_.push_back(elementMapper_.map(element));
+    rowStart_.push_back(neighbors_.size());
+
+    double diagonal = 0;
+    for (IntersectionIterator iIt = gv_.ibegin(element); iIt != gv_.iend(element); ++iIt) {
+      if (!iIt->neighbor())
+	continue;
+
+      const Dune::FieldVector<double, dimension> outsideCenter = iIt->outside()->geometry().center();
+      const double coefficient = iIt->geometry().volume() / (outsideCenter - center).two_norm();
+
+      neighbors_.push_back(elementMapper_.map(*iIt->outside()));
+      coefficients_.push_back(coefficient);
+      diagonal += coefficient;
+    }
+
+    diagonal_.push_back(diagonal > 0 ? diagonal : 1);
+  }
+
+  const GridView gv_;
+  ElementMapper elementMapper_;
+  HaloExchange<GridView> halo_;
+
+  // Stencil in CSR format: row i updates element rows_[i] from neighbors_[rowStart_[i]], ...
+  std::vector<int> rows_, rowStart_, neighbors_;
+  std::vector<double> coefficients_, diagonal_;
+
+  std::vector<double> u_, next_;
+};
+
+#endif
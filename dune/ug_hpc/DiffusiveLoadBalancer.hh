@@ -0,0 +1,249 @@
+#ifndef DIFFUSIVELOADBALANCER_H
+#define DIFFUSIVELOADBALANCER_H
+
+#include <dune/common/parallel/mpihelper.hh>
+#include <dune/grid/common/datahandleif.hh>
+#include <dune/grid/common/mcmgmapper.hh>
+
+#include <algorithm>
+#include <map>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include <mpi.h>
+
+#include <dune/ug_hpc/PartitionConstraints.hh>
+
+
+// Local alternative to a global repartition: load is only exchanged between neighboring partitions, i.e. ranks
+// that own ghost elements of each other.  A first order diffusion scheme on the graph of neighboring ranks
+// computes how much load has to flow across every partition boundary, then boundary elements are shifted
+// towards the less loaded neighbors.  The result is a part vector as returned by ParMetisGridPartitioner.
+template<class GridView>
+struct DiffusiveLoadBalancer {
+#if PARMETIS_MAJOR_VERSION < 4
+  typedef idxtype idx_t;
+#endif
+
+  typedef typename GridView::template Codim<0>::template Partition<Dune::Interior_Partition>::Iterator InteriorElementIterator;
+  typedef typename GridView::template Codim<0>::Entity                                                 Element;
+  typedef typename GridView::IntersectionIterator                                                      IntersectionIterator;
+
+  typedef typename GridView::Grid::GlobalIdSet         GlobalIdSet;
+  typedef typename GridView::Grid::GlobalIdSet::IdType IdType;
+
+  typedef std::map<IdType,int> MapId2Rank;
+
+private:
+  // Sends the rank of the owner of each element to its ghost copies
+  class OwnerExchange : public Dune::CommDataHandleIF<OwnerExchange, int> {
+  public:
+    bool contains (int dim, int codim) const {
+      return 0 == codim;
+    }
+
+    bool fixedsize (int dim, int codim) const {
+      return true;
+    }
+
+    template<class EntityType>
+    size_t size (EntityType& e) const {
+      return 1;
+    }
+
+    template<class MessageBuffer, class EntityType>
+    void gather (MessageBuffer& buff, const EntityType& e) const {
+      buff.write(e.partitionType() == Dune::InteriorEntity ? rank_ : -1);
+    }
+
+    template<class MessageBuffer, class EntityType>
+    void scatter (MessageBuffer& buff, const EntityType& e, size_t n) {
+      int x;
+      buff.read(x);
+
+      if (x >= 0)
+	owner_[globalidset_.id(e)] = x;
+    }
+
+    OwnerExchange (const GlobalIdSet& globalidset, MapId2Rank& owner, int rank) :
+      globalidset_(globalidset),
+      owner_(owner),
+      rank_(rank)
+    {}
+
+  private:
+    const GlobalIdSet& globalidset_;
+    MapId2Rank& owner_;
+    int rank_;
+  };
+
+  // An interior element on the boundary towards a neighboring rank
+  struct Candidate {
+    int index;       // element index from the mapper
+    int weight;      // load of the element
+    int sharedFaces; // number of faces shared with the neighbor
+
+    bool operator<(const Candidate& other) const {
+      return sharedFaces > other.sharedFaces;
+    }
+  };
+
+public:
+  // Ratio of the heaviest rank's load to the average load (collective)
+  static double imbalance(const GridView& gv, const PartitionConstraints<GridView>& constraints = PartitionConstraints<GridView>()) {
+    const double load = localLoad(gv, constraints);
+
+    const double maxLoad = gv.comm().max(load);
+    const double sumLoad = gv.comm().sum(load);
+
+    return (sumLoad > 0) ? maxLoad * gv.comm().size() / sumLoad : 1;
+  }
+
+  // The load of an element is its first constraint weight, or one if the constraints are unweighted.
+  // Every rank runs the same number of diffusion sweeps, each of which is one exchange with the neighbors, and
+  // no global collective.  A rank whose load is within tolerance of the average over itself and its neighbors
+  // keeps all of its elements.
+  static std::vector<unsigned> repartition(const GridView& gv,
+					   const PartitionConstraints<GridView>& constraints = PartitionConstraints<GridView>(),
+					   int iterations = 20, double tolerance = 1.05) {
+    const int rank = gv.comm().rank();
+    MPI_Comm comm = Dune::MPIHelper::getCommunicator();
+
+    // Find the owners of all ghost elements
+    const GlobalIdSet& globalIdSet = gv.grid().globalIdSet();
+
+    MapId2Rank owner;
+    OwnerExchange dh(globalIdSet, owner, rank);
+    gv.communicate(dh, Dune::All_All_Interface, Dune::ForwardCommunication);
+
+    // Collect the boundary elements towards every neighboring rank.  Ghosts are created symmetrically
+    // across partition boundaries, so if we see a ghost of rank j, rank j sees a ghost of ours.
+    typedef Dune::MultipleCodimMultipleGeomTypeMapper<GridView, Dune::MCMGElementLayout> ElementMapper;
+    ElementMapper elementMapper(gv);
+
+    std::map<int, std::vector<Candidate> > candidates;
+    double load = 0;
+
+    for (InteriorElementIterator eIt = gv.template begin<0, Dune::Interior_Partition>(); eIt != gv.template end<0, Dune::Interior_Partition>(); ++eIt) {
+      const int weight = elementLoad(gv, constraints, *eIt);
+      load += weight;
+
+      std::map<int, int> sharedFaces;
+      for (IntersectionIterator iIt = gv.ibegin(*eIt); iIt != gv.iend(*eIt); ++iIt) {
+	if (iIt->neighbor() && iIt->outside()->partitionType() != Dune::InteriorEntity) {
+	  typename MapId2Rank::const_iterator it = owner.find(globalIdSet.id(*iIt->outside()));
+	  if (it != owner.end())
+	    ++sharedFaces[it->second];
+	}
+      }
+
+      for (std::map<int, int>::const_iterator it = sharedFaces.begin(); it != sharedFaces.end(); ++it) {
+	Candidate c;
+	c.index = elementMapper.map(*eIt);
+	c.weight = weight;
+	c.sharedFaces = it->second;
+
+	candidates[it->first].push_back(c);
+      }
+    }
+
+    std::vector<int> neighbors;
+    for (typename std::map<int, std::vector<Candidate> >::const_iterator it = candidates.begin(); it != candidates.end(); ++it)
+      neighbors.push_back(it->first);
+
+    const int numNeighbors = neighbors.size();
+
+    // Diffusion weights alpha_ij = 1 / (max(deg_i, deg_j) + 1) need the degrees of the neighbors
+    std::vector<double> neighborDegree(numNeighbors);
+    const double degree = numNeighbors;
+    exchangeWithNeighbors(degree, neighborDegree, neighbors, comm);
+
+    std::vector<double> alpha(numNeighbors);
+    for (int k = 0; k < numNeighbors; ++k)
+      alpha[k] = 1. / (std::max(degree, neighborDegree[k]) + 1);
+
+    // Iterate x_i <- x_i - sum_j alpha_ij (x_i - x_j) and accumulate the flow across every boundary.  The
+    // sweeps run in lock-step with the neighbors, so a rank cannot stop early on its own.
+    std::vector<double> flow(numNeighbors, 0), neighborLoad(numNeighbors);
+    double x = load, neighborhoodLoad = load;
+
+    for (int t = 0; t < iterations; ++t) {
+      exchangeWithNeighbors(x, neighborLoad, neighbors, comm);
+
+      if (t == 0)
+	neighborhoodLoad = (load + std::accumulate(neighborLoad.begin(), neighborLoad.end(), 0.)) / (numNeighbors + 1);
+
+      double outflow = 0;
+      for (int k = 0; k < numNeighbors; ++k) {
+	const double f = alpha[k] * (x - neighborLoad[k]);
+	flow[k] += f;
+	outflow += f;
+      }
+
+      x -= outflow;
+    }
+
+    // Realize the outgoing flows by moving the boundary elements that share most faces with the neighbor first
+    std::vector<unsigned> part(gv.size(0), rank);
+    std::vector<bool> moved(gv.size(0), false);
+
+    if (load <= tolerance * neighborhoodLoad)
+      return part;
+
+    for (int k = 0; k < numNeighbors; ++k) {
+      if (flow[k] <= 0)
+	continue;
+
+      std::vector<Candidate>& c = candidates[neighbors[k]];
+      std::stable_sort(c.begin(), c.end());
+
+      double sent = 0;
+      for (size_t l = 0; l < c.size() && sent + c[l].weight <= flow[k]; ++l) {
+	if (moved[c[l].index])
+	  continue;
+
+	part[c[l].index] = neighbors[k];
+	moved[c[l].index] = true;
+	sent += c[l].weight;
+      }
+    }
+
+    return part;
+  }
+
+private:
+  static int elementLoad(const GridView& gv, const PartitionConstraints<GridView>& constraints, const Element& element) {
+    if (!constraints.weighted())
+      return 1;
+
+    std::vector<idx_t> w(constraints.ncon());
+    constraints.weights(gv, element, w.data());
+
+    return w[0];
+  }
+
+  static double localLoad(const GridView& gv, const PartitionConstraints<GridView>& constraints) {
+    double load = 0;
+    for (InteriorElementIterator eIt = gv.template begin<0, Dune::Interior_Partition>(); eIt != gv.template end<0, Dune::Interior_Partition>(); ++eIt)
+      load += elementLoad(gv, constraints, *eIt);
+
+    return load;
+  }
+
+  // Sends value to all neighbors and receives one value from each of them
+  static void exchangeWithNeighbors(double value, std::vector<double>& received, const std::vector<int>& neighbors, MPI_Comm comm) {
+    const int numNeighbors = neighbors.size();
+    const int tag = 4711;
+
+    std::vector<MPI_Request> requests(2*numNeighbors);
+    for (int k = 0; k < numNeighbors; ++k) {
+      MPI_Irecv(&received[k], 1, MPI_DOUBLE, neighbors[k], tag, comm, &requests[k]);
+      MPI_Isend(&value, 1, MPI_DOUBLE, neighbors[k], tag, comm, &requests[numNeighbors + k]);
+    }
+
+    MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+  }
+};
+
+#endif
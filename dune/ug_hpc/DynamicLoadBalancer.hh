@@ -0,0 +1,185 @@
+#ifndef DYNAMICLOADBALANCER_H
+#define DYNAMICLOADBALANCER_H
+
+#include <dune/common/parallel/mpihelper.hh>
+
+#include <iostream>
+#include <vector>
+
+#include <mpi.h>
+
+#include <parmetis.h>
+
+#include <dune/ug_hpc/ElasticPartCount.hh>
+#include <dune/ug_hpc/GlobalUniqueIndex.hh>
+#include <dune/ug_hpc/GraphPartitioner.hh>
+#include <dune/ug_hpc/ItrController.hh>
+#include <dune/ug_hpc/MemoryUsage.hh>
+#include <dune/ug_hpc/Parmetisgridpartitioner.hh>
+#include <dune/ug_hpc/PartitionConstraints.hh>
+#include <dune/ug_hpc/PartitionRemapping.hh>
+#include <dune/ug_hpc/SpaceFillingCurveOrdering.hh>
+
+
+// Persistent dynamic load balancer for a distributed grid: one object per grid that repartitions the leaf
+// elements and migrates them with loadBalance(part, 0).  It owns the graph and the part buffers, which keep
+// their capacity from call to call instead of being allocated by every static call of ParMetisGridPartitioner,
+// the itr controller and statistics of all calls.  The global element index refers to the leaf grid view of
+// its call, so it is built anew each time.
+//
+//   DynamicLoadBalancer<GridView> balancer(grid);
+//   ...
+//   grid.adapt(); grid.postAdapt();
+//   balancer.balance(constraints);
+template<class GridView>
+class DynamicLoadBalancer {
+public:
+#if PARMETIS_MAJOR_VERSION < 4
+  typedef idxtype idx_t;
+  typedef float real_t;
+#endif
+
+  typedef typename GridView::Grid Grid;
+
+  struct Options {
+    GraphPartitioner::Method method;  // partitioner of every repartition
+    real_t itr;                       // ratio of communication to migration time, start value if autoItr is set
+    bool autoItr;                     // derive itr from the measured halo exchange and migration times
+    double iterationsPerStep;         // autoItr: halo exchanges of the solver between two repartitions
+    LabelAssignment::Method remap;    // relabeling of the parts so that load stays in place
+    long minElementsPerRank;          // elastic part count, see ElasticPartCount (0: always all ranks)
+
+    Options() : method(GraphPartitioner::AdaptiveRepart), itr(1000), autoItr(false), iterationsPerStep(100),
+		remap(LabelAssignment::None), minElementsPerRank(0)
+    {}
+  };
+
+  // Totals over all calls of balance()
+  struct Statistics {
+    int calls;
+    double graphTime;         // building the index and the graph, in s
+    double partitionTime;     // partitioner and relabeling, in s
+    double migrationTime;     // loadBalance, in s
+    double migratedElements;  // elements that changed their rank
+    double retained;          // fraction of the load that kept its rank in the last call
+    int parts;                // ranks that received elements in the last call
+
+    Statistics() : calls(0), graphTime(0), partitionTime(0), migrationTime(0), migratedElements(0), retained(1), parts(0) {}
+  };
+
+  explicit DynamicLoadBalancer(Grid& grid, const Options& options = Options(), MemoryStatistics* memoryStatistics = NULL) :
+    grid_(grid), options_(options), memoryStatistics_(memoryStatistics),
+    itrController_(options.itr, options.iterationsPerStep)
+  {}
+
+  // Collective: repartitions the current leaf grid and migrates it.  The constraints determine the element
+  // weights; with an up-to-date ordering, the graph vertices are laid out along it.  Returns the number of
+  // elements that changed their rank, summed over all ranks.
+  double balance(const PartitionConstraints<GridView>& constraints = PartitionConstraints<GridView>(),
+		 const SpaceFillingCurveOrdering<GridView>* ordering = NULL) {
+    const GridView gv = grid_.leafGridView();
+    const int size = gv.comm().size();
+
+    // Slowest rank per phase
+    double t = MPI_Wtime();
+
+    GlobalUniqueIndex<GridView> index(gv, ordering);
+    if (memoryStatistics_)
+      memoryStatistics_->sample("globalIndex");
+
+    graph_.vtxdist.assign(index.indexOffset().begin(), index.indexOffset().end());
+    graph_.ncon = constraints.ncon();
+    ParMetisGridPartitioner<GridView>::buildGraph(gv, index, constraints, graph_.xadj, graph_.adjncy, graph_.vwgt, ordering);
+    if (memoryStatistics_)
+      memoryStatistics_->sample("graph");
+
+    statistics_.graphTime += gv.comm().max(MPI_Wtime() - t);
+    t = MPI_Wtime();
+
+    const idx_t nparts = ElasticPartCount(options_.minElementsPerRank).parts(graph_.vtxdist.back(), size);
+    statistics_.parts = nparts;
+    tpwgts_ = constraints.tpwgts(nparts);
+    ubvec_ = constraints.ubvec();
+
+    part_.assign(graph_.numVertices(), gv.comm().rank());
+    GraphPartitioner::partition(options_.method, graph_, nparts, tpwgts_, ubvec_, itr(), part_, Dune::MPIHelper::getCommunicator());
+
+    interiorPart_.assign(part_.begin(), part_.end());
+    std::vector<unsigned> part = ParMetisGridPartitioner<GridView>::elementPart(gv, interiorPart_, ordering);
+
+    if (options_.remap != LabelAssignment::None)
+      statistics_.retained = PartitionRemapping<GridView>::remap(gv, part, size, options_.remap, constraints);
+
+    statistics_.partitionTime += gv.comm().max(MPI_Wtime() - t);
+
+    const double migrated = ItrController<GridView>::localMigratedElements(gv, part);
+
+    t = MPI_Wtime();
+    grid_.loadBalance(part, 0);
+    const double migrationTime = MPI_Wtime() - t;
+
+    if (memoryStatistics_)
+      memoryStatistics_->sample("loadBalance");
+
+    statistics_.migrationTime += gv.comm().max(migrationTime);
+    ++statistics_.calls;
+
+    // The controller needs the slowest rank, the statistics count all elements
+    const double moved = gv.comm().sum(migrated);
+    statistics_.migratedElements += moved;
+
+    if (options_.autoItr) {
+      const GridView balanced = grid_.leafGridView();
+
+      itrController_.observeMigration(balanced, balanced.comm().max(migrated), migrationTime);
+      itrController_.probeCommunication(balanced);
+      itrController_.update();
+    }
+
+    return moved;
+  }
+
+  real_t itr() const {
+    return options_.autoItr ? itrController_.itr() : options_.itr;
+  }
+
+  const Options& options() const {
+    return options_;
+  }
+
+  Options& options() {
+    return options_;
+  }
+
+  const Statistics& statistics() const {
+    return statistics_;
+  }
+
+  // Prints the statistics on rank 0
+  void report(std::ostream& out = std::cout) const {
+    if (0 != grid_.comm().rank())
+      return;
+
+    out << "Load balancing: " << statistics_.calls << " calls, " << GraphPartitioner::name(options_.method) << std::endl
+	<< "   graph            " << statistics_.graphTime << " s" << std::endl
+	<< "   partition        " << statistics_.partitionTime << " s" << std::endl
+	<< "   migration        " << statistics_.migrationTime << " s, " << statistics_.migratedElements << " elements" << std::endl
+	<< "   parts            " << statistics_.parts << " of " << grid_.comm().size() << " ranks in the last call" << std::endl
+	<< "   itr              " << itr() << std::endl;
+  }
+
+private:
+  Grid& grid_;
+  Options options_;
+  MemoryStatistics* memoryStatistics_;
+  ItrController<GridView> itrController_;
+  Statistics statistics_;
+
+  // Buffers of the last call, they keep their capacity
+  GraphPartitioner::Graph graph_;
+  std::vector<idx_t> part_;
+  std::vector<unsigned> interiorPart_;
+  std::vector<real_t> tpwgts_, ubvec_;
+};
+
+#endif
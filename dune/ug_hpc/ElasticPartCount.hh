@@ -0,0 +1,54 @@
+#ifndef ELASTICPARTCOUNT_H
+#define ELASTICPARTCOUNT_H
+
+#include <dune/grid/common/gridenums.hh>
+
+#include <algorithm>
+
+
+// Number of parts for a grid of a given size.  Every part gets at least minElementsPerRank elements, so a coarse
+// grid is concentrated on a few ranks, where the halo exchange does not dominate the work, and spreads out over
+// all ranks as it is refined.  The remaining ranks are left without elements; a minimum of zero always uses all
+// ranks.  Parts are labeled 0, ..., parts-1, the partitioners assign them to ranks.
+class ElasticPartCount {
+public:
+  explicit ElasticPartCount(long minElementsPerRank = 0) :
+    minElementsPerRank_(minElementsPerRank)
+  {}
+
+  bool enabled() const {
+    return minElementsPerRank_ > 0;
+  }
+
+  long minElementsPerRank() const {
+    return minElementsPerRank_;
+  }
+
+  // Parts for a grid of `elements` elements in total on `size` ranks
+  int parts(long elements, int size) const {
+    if (!enabled())
+      return size;
+
+    return static_cast<int>(std::max(1L, std::min<long>(size, elements / minElementsPerRank_)));
+  }
+
+  // Collective: parts for the interior leaf elements of gv
+  template<class GridView>
+  int parts(const GridView& gv) const {
+    typedef typename GridView::template Codim<0>::template Partition<Dune::Interior_Partition>::Iterator InteriorElementIterator;
+
+    if (!enabled())
+      return gv.comm().size();
+
+    long elements = 0;
+    for (InteriorElementIterator eIt = gv.template begin<0, Dune::Interior_Partition>(); eIt != gv.template end<0, Dune::Interior_Partition>(); ++eIt)
+      ++elements;
+
+    return parts(gv.comm().sum(elements), gv.comm().size());
+  }
+
+private:
+  long minElementsPerRank_;
+};
+
+#endif
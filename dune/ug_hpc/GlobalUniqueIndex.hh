@@ -10,6 +10,8 @@
 #include <dune/common/parallel/mpihelper.hh>
 #include <dune/grid/common/datahandleif.hh>
 
+#include <dune/ug_hpc/SpaceFillingCurveOrdering.hh>
+
 template<class GridView>
 class GlobalUniqueIndex
 {
@@ -94,8 +96,10 @@ public:
    * GridView object, we calculate the complete set of global unique indices
    * so that we can then later query the global index, by directly passing
    * the entity in question, and the respective global index is returned.
+   * If an ordering is given, the owned entities are numbered along it instead
+   * of in traversal order.
    */
-  GlobalUniqueIndex(const GridView& gridview) :
+  GlobalUniqueIndex(const GridView& gridview, const SpaceFillingCurveOrdering<GridView>* ordering = NULL) :
     grid_(gridview.grid()),
     gridview_(gridview)
   {
@@ -152,7 +156,7 @@ public:
 
       /** if the entity is owned by the process, go ahead with computing the global index */
       if(iter->partitionType() == Dune::InteriorEntity) {
-	const int gindex = myoffset + globalcontrib;    /** compute global index */
+	const int gindex = myoffset + (ordering ? ordering->elementIndex(*iter) : globalcontrib); /** compute global index */
 
 	globalIndex_[id] = gindex;                      /** insert pair (key, datum) into the map */
 	globalcontrib++;                                /** increment contribution to global index */
@@ -164,9 +168,15 @@ public:
     }
 
     /** 2nd stage of global index calculation: communicate global index for non-owned entities */
+    exchange();
+  }
 
+  /**\brief Sends the global index of every owned entity to its copies on the other processes; called by the
+   * constructor, calling it again sends the same indices */
+  void exchange()
+  {
     /** create the data handle and communicate */
-    IndexExchange dh(globalIdSet, globalIndex_);
+    IndexExchange dh(gridview_.grid().globalIdSet(), globalIndex_);
     gridview_.communicate(dh, Dune::All_All_Interface, Dune::ForwardCommunication);
   }
 
@@ -182,6 +192,15 @@ public:
     return gindex;
   }
 
+  /**\brief Like globalIndex, but returns -1 for entities that are unknown on this process */
+  int findGlobalIndex(const Entity& entity) const
+  {
+    const GlobalIdSet& globalIdSet = gridview_.grid().globalIdSet();
+    const typename MapId2Index::const_iterator it = globalIndex_.find(globalIdSet.id(entity));
+
+    return (it != globalIndex_.end()) ? it->second : -1;
+  }
+
   unsigned int nGlobalEntity() {
     return nGlobalEntity_;
   }
@@ -0,0 +1,534 @@
+#ifndef GRAPHPARTITIONER_H
+#define GRAPHPARTITIONER_H
+
+#include <dune/common/exceptions.hh>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+
+#include <mpi.h>
+#include <parmetis.h>
+
+#if HAVE_PTSCOTCH
+#include <ptscotch.h>
+#endif
+
+#if HAVE_ZOLTAN
+#include <zoltan.h>
+#endif
+
+#include <dune/ug_hpc/PartitionRemapping.hh>
+
+
+// Backend-neutral partitioning of a distributed graph in the CSR format of ParMETIS, as built by
+// ParMetisGridPartitioner::buildGraph.  ParMETIS is always available; PT-Scotch and Zoltan are used if they were
+// found at configure time (HAVE_PTSCOTCH, HAVE_ZOLTAN).  All backends take the current owner of every vertex and
+// return its new part, so the result can be fed to ParMetisGridPartitioner::elementPart.
+struct GraphPartitioner {
+#if PARMETIS_MAJOR_VERSION < 4
+  typedef idxtype idx_t;
+  typedef float real_t;
+#endif
+
+  enum Method {
+    AdaptiveRepart, // ParMETIS_V3_AdaptiveRepart, trades edgecut against migration by itr
+    PartKway,       // ParMETIS_V3_PartKway, from scratch
+    RefineKway,     // ParMETIS_V3_RefineKway, improves the current partition
+    Scotch,         // PT-Scotch SCOTCH_dgraphPart, from scratch, balances the first constraint only
+    Zoltan          // Zoltan PHG hypergraph repartitioning, trades edgecut against migration by itr
+  };
+
+  // One rank's share of the graph; vwgt is empty if the graph is unweighted
+  struct Graph {
+    std::vector<idx_t> vtxdist, xadj, adjncy, vwgt;
+    idx_t ncon;
+
+    Graph() : ncon(1) {}
+
+    idx_t numVertices() const {
+      return xadj.empty() ? 0 : xadj.size() - 1;
+    }
+
+    bool weighted() const {
+      return !vwgt.empty();
+    }
+  };
+
+  // Quality of a partition of the graph
+  struct Quality {
+    long edgecut;                   // number of edges between different parts
+    std::vector<double> imbalance;  // max part weight over average part weight, per constraint
+    double migration;               // fraction of the first constraint's weight that changes its owner
+  };
+
+  static Method method(const std::string& name) {
+    Method m;
+    if (name == "adaptive")
+      m = AdaptiveRepart;
+    else if (name == "kway")
+      m = PartKway;
+    else if (name == "refine")
+      m = RefineKway;
+    else if (name == "scotch")
+      m = Scotch;
+    else if (name == "zoltan")
+      m = Zoltan;
+    else
+      DUNE_THROW(Dune::Exception, "Unknown partitioning method " << name << ".");
+
+    if (!available(m))
+      DUNE_THROW(Dune::NotImplemented, "Partitioning method " << name << " was not found at configure time.");
+
+    return m;
+  }
+
+  static std::string name(Method m) {
+    const char* names[] = {"adaptive", "kway", "refine", "scotch", "zoltan"};
+    return names[m];
+  }
+
+  static bool available(Method m) {
+#if !HAVE_PTSCOTCH
+    if (m == Scotch)
+      return false;
+#endif
+#if !HAVE_ZOLTAN
+    if (m == Zoltan)
+      return false;
+#endif
+
+    return true;
+  }
+
+  // All methods this build supports
+  static std::vector<Method> methods() {
+    std::vector<Method> result;
+    for (int m = AdaptiveRepart; m <= Zoltan; ++m)
+      if (available(Method(m)))
+	result.push_back(Method(m));
+
+    return result;
+  }
+
+  // Collective: on entry, part holds the current owner of every local vertex, on return its new part.
+  // tpwgts and ubvec are given per part and constraint as for ParMETIS, a negative seed selects the default
+  // random seed of ParMETIS.  nparts may differ from the number of ranks, e.g. for an ElasticPartCount.
+  //
+  // ParMETIS rejects ranks without vertices, which an elastic part count leaves behind, so if there are any,
+  // only the ranks with vertices partition the graph on a communicator of their own.  Their parts are then
+  // mapped to ranks so that the i-th active rank keeps label i and the labels beyond the active ranks go to the
+  // idle ranks in order; the backends' notion of parts that stay in place carries over.  With fewer parts
+  // than partitioning ranks, the owners are no valid parts for AdaptiveRepart and RefineKway, which therefore
+  // partition from scratch with PartKway and relabel the parts like Scotch.
+  static void partition(Method m, Graph& graph, idx_t nparts, std::vector<real_t>& tpwgts, std::vector<real_t>& ubvec,
+			real_t itr, std::vector<idx_t>& part, MPI_Comm comm, int seed = -1) {
+    int size;
+    MPI_Comm_size(comm, &size);
+
+    // Ranks in label order: the ones with vertices first
+    std::vector<int> labelRank, idle;
+    for (int r = 0; r < size; ++r)
+      (graph.vtxdist[r+1] > graph.vtxdist[r] ? labelRank : idle).push_back(r);
+
+    const int numActive = labelRank.size();
+    if (numActive == size) {
+      backend(m, graph, nparts, tpwgts, ubvec, itr, part, comm, seed);
+      return;
+    }
+
+    labelRank.insert(labelRank.end(), idle.begin(), idle.end());
+
+    std::vector<int> rankLabel(size);
+    for (int l = 0; l < size; ++l)
+      rankLabel[labelRank[l]] = l;
+
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    const bool active = (rankLabel[rank] < numActive);
+
+    MPI_Comm activeComm;
+    MPI_Comm_split(comm, active ? 0 : MPI_UNDEFINED, rank, &activeComm);
+
+    if (!active)
+      return;
+
+    // Vertex distribution over the active ranks, and the owners as their labels
+    std::vector<idx_t> vtxdist(numActive + 1);
+    for (int l = 0; l < numActive; ++l)
+      vtxdist[l] = graph.vtxdist[labelRank[l]];
+    vtxdist[numActive] = graph.vtxdist[size];
+
+    graph.vtxdist.swap(vtxdist);
+
+    for (size_t i = 0; i < part.size(); ++i)
+      part[i] = rankLabel[part[i]];
+
+    backend(m, graph, nparts, tpwgts, ubvec, itr, part, activeComm, seed);
+
+    graph.vtxdist.swap(vtxdist);
+    MPI_Comm_free(&activeComm);
+
+    for (size_t i = 0; i < part.size(); ++i)
+      part[i] = labelRank[part[i]];
+  }
+
+  // Collective: evaluates the new parts of the local vertices against their owners
+  static Quality evaluate(const Graph& graph, const std::vector<idx_t>& part, const std::vector<idx_t>& owner,
+			  idx_t nparts, MPI_Comm comm) {
+    int size;
+    MPI_Comm_size(comm, &size);
+
+    const int n = graph.numVertices();
+    const int ncon = graph.ncon;
+
+    // Parts of all vertices, the edges reference global indices
+    std::vector<int> counts(size), displs(size);
+    for (int r = 0; r < size; ++r) {
+      counts[r] = graph.vtxdist[r+1] - graph.vtxdist[r];
+      displs[r] = graph.vtxdist[r];
+    }
+
+    std::vector<int> localPart(part.begin(), part.end()), globalPart(graph.vtxdist.back());
+    MPI_Allgatherv(localPart.data(), n, MPI_INT, globalPart.data(), counts.data(), displs.data(), MPI_INT, comm);
+
+    long localCut = 0;
+    std::vector<double> localWeight(nparts*ncon, 0);
+    double localMoved = 0, localTotal = 0;
+
+    for (int i = 0; i < n; ++i) {
+      for (int k = graph.xadj[i]; k < graph.xadj[i+1]; ++k)
+	if (globalPart[graph.adjncy[k]] != part[i])
+	  ++localCut;
+
+      for (int j = 0; j < ncon; ++j)
+	localWeight[part[i]*ncon + j] += graph.weighted() ? graph.vwgt[i*ncon + j] : 1;
+
+      const double w = graph.weighted() ? graph.vwgt[i*ncon] : 1;
+      localTotal += w;
+      if (part[i] != owner[i])
+	localMoved += w;
+    }
+
+    Quality quality;
+
+    // Every cut edge is seen from both of its ends
+    MPI_Allreduce(&localCut, &quality.edgecut, 1, MPI_LONG, MPI_SUM, comm);
+    quality.edgecut /= 2;
+
+    std::vector<double> weight(localWeight.size());
+    MPI_Allreduce(localWeight.data(), weight.data(), weight.size(), MPI_DOUBLE, MPI_SUM, comm);
+
+    quality.imbalance.assign(ncon, 0);
+    for (int j = 0; j < ncon; ++j) {
+      double total = 0, heaviest = 0;
+      for (int p = 0; p < nparts; ++p) {
+	total += weight[p*ncon + j];
+	heaviest = std::max(heaviest, weight[p*ncon + j]);
+      }
+
+      quality.imbalance[j] = (total > 0) ? heaviest * nparts / total : 1;
+    }
+
+    double moved, total;
+    MPI_Allreduce(&localMoved, &moved, 1, MPI_DOUBLE, MPI_SUM, comm);
+    MPI_Allreduce(&localTotal, &total, 1, MPI_DOUBLE, MPI_SUM, comm);
+    quality.migration = (total > 0) ? moved / total : 0;
+
+    return quality;
+  }
+
+private:
+  static void backend(Method m, Graph& graph, idx_t nparts, std::vector<real_t>& tpwgts, std::vector<real_t>& ubvec,
+		      real_t itr, std::vector<idx_t>& part, MPI_Comm comm, int seed) {
+    switch (m) {
+    case AdaptiveRepart:
+    case PartKway:
+    case RefineKway:
+      parmetis(m, graph, nparts, tpwgts, ubvec, itr, part, comm, seed);
+      break;
+
+    case Scotch:
+      if (!uniform(tpwgts))
+	DUNE_THROW(Dune::NotImplemented, "PT-Scotch cannot balance toward target weights per part.");
+      scotch(graph, nparts, ubvec, part, comm);
+      break;
+
+    case Zoltan:
+      if (!uniform(tpwgts))
+	DUNE_THROW(Dune::NotImplemented, "Zoltan cannot balance toward target weights per part.");
+      zoltan(graph, nparts, ubvec, itr, part, comm);
+      break;
+    }
+  }
+
+  // True if tpwgts gives every part the same target
+  static bool uniform(const std::vector<real_t>& tpwgts) {
+    return tpwgts.empty() || *std::min_element(tpwgts.begin(), tpwgts.end()) == *std::max_element(tpwgts.begin(), tpwgts.end());
+  }
+
+  static void parmetis(Method m, Graph& graph, idx_t nparts, std::vector<real_t>& tpwgts, std::vector<real_t>& ubvec,
+		       real_t itr, std::vector<idx_t>& part, MPI_Comm comm, int seed) {
+    idx_t wgtflag = graph.weighted() ? 2 : 0;                  // weights on vertices only
+    idx_t numflag = 0;                                         // we are using C-style arrays
+    idx_t ncon = graph.ncon;                                   // number of balance constraints
+    idx_t options[4] = {0, 0, 0, 0};                           // use default values for random seed, output and coupling
+    if (seed >= 0) {
+      options[0] = 1;                                          // given random seed, no output, parts stay on their ranks
+      options[2] = seed;
+      options[3] = PARMETIS_PSR_COUPLED;
+    }
+    idx_t edgecut;                                             // will store number of edges cut by partition
+    idx_t* vwgt = graph.weighted() ? graph.vwgt.data() : NULL;
+
+    // The owners of ranks from nparts on are no valid parts to start from
+    int size;
+    MPI_Comm_size(comm, &size);
+
+    const bool shrink = (nparts < size && m != PartKway);
+    if (shrink)
+      m = PartKway;
+
+#if PARMETIS_MAJOR_VERSION >= 4
+    int OK = METIS_OK;
+#endif
+
+    switch (m) {
+    case AdaptiveRepart:
+#if PARMETIS_MAJOR_VERSION >= 4
+      OK =
+#endif
+	ParMETIS_V3_AdaptiveRepart(graph.vtxdist.data(), graph.xadj.data(), graph.adjncy.data(), vwgt, NULL, NULL,
+				   &wgtflag, &numflag, &ncon, &nparts, tpwgts.data(), ubvec.data(),
+				   &itr, options, &edgecut, part.data(), &comm);
+      break;
+
+    case PartKway:
+#if PARMETIS_MAJOR_VERSION >= 4
+      OK =
+#endif
+	ParMETIS_V3_PartKway(graph.vtxdist.data(), graph.xadj.data(), graph.adjncy.data(), vwgt, NULL,
+			     &wgtflag, &numflag, &ncon, &nparts, tpwgts.data(), ubvec.data(),
+			     options, &edgecut, part.data(), &comm);
+      break;
+
+    default:
+#if PARMETIS_MAJOR_VERSION >= 4
+      OK =
+#endif
+	ParMETIS_V3_RefineKway(graph.vtxdist.data(), graph.xadj.data(), graph.adjncy.data(), vwgt, NULL,
+			       &wgtflag, &numflag, &ncon, &nparts, tpwgts.data(), ubvec.data(),
+			       options, &edgecut, part.data(), &comm);
+      break;
+    }
+
+#if PARMETIS_MAJOR_VERSION >= 4
+    if (OK != METIS_OK)
+      DUNE_THROW(Dune::Exception, "ParMETIS is not happy.");
+#endif
+
+    // Keep as much load as possible on its current rank
+    if (shrink)
+      relabel(graph, part, nparts, comm);
+  }
+
+  static void scotch(const Graph& graph, idx_t nparts, const std::vector<real_t>& ubvec, std::vector<idx_t>& part, MPI_Comm comm) {
+#if HAVE_PTSCOTCH
+    const SCOTCH_Num n = graph.numVertices();
+
+    // SCOTCH_Num need not be idx_t; Scotch balances a single vertex weight
+    std::vector<SCOTCH_Num> xadj(graph.xadj.begin(), graph.xadj.end()), adjncy(graph.adjncy.begin(), graph.adjncy.end());
+    std::vector<SCOTCH_Num> vwgt;
+    if (graph.weighted())
+      for (SCOTCH_Num i = 0; i < n; ++i)
+	vwgt.push_back(graph.vwgt[i*graph.ncon]);
+
+    // Keep the buffers valid on ranks without vertices
+    xadj.resize(std::max<size_t>(xadj.size(), 1), 0);
+    adjncy.resize(std::max<size_t>(adjncy.size(), 1), 0);
+
+    SCOTCH_Dgraph dgraph;
+    SCOTCH_Strat strat;
+
+    if (SCOTCH_dgraphInit(&dgraph, comm) != 0)
+      DUNE_THROW(Dune::Exception, "PT-Scotch could not initialize the graph.");
+
+    const SCOTCH_Num edges = graph.adjncy.size();
+    if (SCOTCH_dgraphBuild(&dgraph, 0, n, n, xadj.data(), xadj.data() + 1, vwgt.empty() ? NULL : vwgt.data(), NULL,
+			   edges, edges, adjncy.data(), NULL, NULL) != 0)
+      DUNE_THROW(Dune::Exception, "PT-Scotch could not build the graph.");
+
+    SCOTCH_stratInit(&strat);
+    SCOTCH_stratDgraphMapBuild(&strat, SCOTCH_STRATDEFAULT, nparts, nparts, ubvec[0] - 1);
+
+    std::vector<SCOTCH_Num> result(std::max<SCOTCH_Num>(n, 1));
+    const int status = SCOTCH_dgraphPart(&dgraph, nparts, &strat, result.data());
+
+    SCOTCH_stratExit(&strat);
+    SCOTCH_dgraphExit(&dgraph);
+
+    if (status != 0)
+      DUNE_THROW(Dune::Exception, "PT-Scotch is not happy.");
+
+    // Scotch partitions from scratch, keep as much load as possible on its current rank
+    std::vector<idx_t> newPart(result.begin(), result.begin() + n);
+    relabel(graph, newPart, nparts, comm);
+    part.swap(newPart);
+#else
+    DUNE_THROW(Dune::NotImplemented, "PT-Scotch was not found at configure time.");
+#endif
+  }
+
+  static void zoltan(const Graph& graph, idx_t nparts, const std::vector<real_t>& ubvec, real_t itr,
+		     std::vector<idx_t>& part, MPI_Comm comm) {
+#if HAVE_ZOLTAN
+    static bool initialized = false;
+    if (!initialized) {
+      float version;
+      if (Zoltan_Initialize(0, NULL, &version) != ZOLTAN_OK)
+	DUNE_THROW(Dune::Exception, "Zoltan could not be initialized.");
+      initialized = true;
+    }
+
+    struct Zoltan_Struct* zz = Zoltan_Create(comm);
+
+    std::ostringstream ncon, num, tolerance, multiplier;
+    ncon << (graph.weighted() ? graph.ncon : 0);
+    num << nparts;
+    tolerance << ubvec[0];
+    multiplier << itr;
+
+    Zoltan_Set_Param(zz, "DEBUG_LEVEL", "0");
+    Zoltan_Set_Param(zz, "LB_METHOD", "GRAPH");
+    Zoltan_Set_Param(zz, "GRAPH_PACKAGE", "PHG");
+    Zoltan_Set_Param(zz, "LB_APPROACH", "REPARTITION");
+    Zoltan_Set_Param(zz, "NUM_GID_ENTRIES", "1");
+    Zoltan_Set_Param(zz, "NUM_LID_ENTRIES", "1");
+    Zoltan_Set_Param(zz, "RETURN_LISTS", "PARTS");
+    Zoltan_Set_Param(zz, "OBJ_WEIGHT_DIM", ncon.str().c_str());
+    Zoltan_Set_Param(zz, "EDGE_WEIGHT_DIM", "0");
+    Zoltan_Set_Param(zz, "NUM_GLOBAL_PARTS", num.str().c_str());
+    Zoltan_Set_Param(zz, "IMBALANCE_TOL", tolerance.str().c_str());
+    Zoltan_Set_Param(zz, "PHG_REPART_MULTIPLIER", multiplier.str().c_str());
+
+    ZoltanData data;
+    data.graph = &graph;
+    MPI_Comm_rank(comm, &data.rank);
+
+    Zoltan_Set_Num_Obj_Fn(zz, zoltanNumObjects, &data);
+    Zoltan_Set_Obj_List_Fn(zz, zoltanObjectList, &data);
+    Zoltan_Set_Num_Edges_Multi_Fn(zz, zoltanNumEdges, &data);
+    Zoltan_Set_Edge_List_Multi_Fn(zz, zoltanEdgeList, &data);
+
+    int changes, numGidEntries, numLidEntries, numImport, numExport;
+    ZOLTAN_ID_PTR importGlobalIds, importLocalIds, exportGlobalIds, exportLocalIds;
+    int *importProcs, *importToPart, *exportProcs, *exportToPart;
+
+    const int status =
+      Zoltan_LB_Partition(zz, &changes, &numGidEntries, &numLidEntries,
+			  &numImport, &importGlobalIds, &importLocalIds, &importProcs, &importToPart,
+			  &numExport, &exportGlobalIds, &exportLocalIds, &exportProcs, &exportToPart);
+
+    // With RETURN_LISTS = PARTS, the export list holds the new part of every local vertex
+    if (status == ZOLTAN_OK)
+      for (int i = 0; i < numExport; ++i)
+	part[exportLocalIds[i]] = exportToPart[i];
+
+    Zoltan_LB_Free_Part(&importGlobalIds, &importLocalIds, &importProcs, &importToPart);
+    Zoltan_LB_Free_Part(&exportGlobalIds, &exportLocalIds, &exportProcs, &exportToPart);
+    Zoltan_Destroy(&zz);
+
+    if (status != ZOLTAN_OK)
+      DUNE_THROW(Dune::Exception, "Zoltan is not happy.");
+#else
+    DUNE_THROW(Dune::NotImplemented, "Zoltan was not found at configure time.");
+#endif
+  }
+
+#if HAVE_ZOLTAN
+  // Passed to the Zoltan query functions
+  struct ZoltanData {
+    const Graph* graph;
+    int rank;
+  };
+
+  static int zoltanNumObjects(void* data, int* ierr) {
+    *ierr = ZOLTAN_OK;
+    return static_cast<ZoltanData*>(data)->graph->numVertices();
+  }
+
+  static void zoltanObjectList(void* data, int numGidEntries, int numLidEntries, ZOLTAN_ID_PTR globalIds, ZOLTAN_ID_PTR localIds,
+			       int wgtDim, float* objWgts, int* ierr) {
+    const Graph& graph = *static_cast<ZoltanData*>(data)->graph;
+    const int rank = static_cast<ZoltanData*>(data)->rank;
+
+    for (idx_t i = 0; i < graph.numVertices(); ++i) {
+      globalIds[i] = graph.vtxdist[rank] + i;
+      localIds[i] = i;
+
+      for (int j = 0; j < wgtDim; ++j)
+	objWgts[i*wgtDim + j] = graph.vwgt[i*graph.ncon + j];
+    }
+
+    *ierr = ZOLTAN_OK;
+  }
+
+  static void zoltanNumEdges(void* data, int numGidEntries, int numLidEntries, int numObj, ZOLTAN_ID_PTR globalIds, ZOLTAN_ID_PTR localIds,
+			     int* numEdges, int* ierr) {
+    const Graph& graph = *static_cast<ZoltanData*>(data)->graph;
+
+    for (int i = 0; i < numObj; ++i)
+      numEdges[i] = graph.xadj[localIds[i]+1] - graph.xadj[localIds[i]];
+
+    *ierr = ZOLTAN_OK;
+  }
+
+  static void zoltanEdgeList(void* data, int numGidEntries, int numLidEntries, int numObj, ZOLTAN_ID_PTR globalIds, ZOLTAN_ID_PTR localIds,
+			     int* numEdges, ZOLTAN_ID_PTR neighborGlobalIds, int* neighborProcs, int wgtDim, float* edgeWgts, int* ierr) {
+    const Graph& graph = *static_cast<ZoltanData*>(data)->graph;
+
+    int k = 0;
+    for (int i = 0; i < numObj; ++i)
+      for (idx_t e = graph.xadj[localIds[i]]; e < graph.xadj[localIds[i]+1]; ++e, ++k) {
+	neighborGlobalIds[k] = graph.adjncy[e];
+	neighborProcs[k] = std::upper_bound(graph.vtxdist.begin(), graph.vtxdist.end(), graph.adjncy[e]) - graph.vtxdist.begin() - 1;
+      }
+
+    *ierr = ZOLTAN_OK;
+  }
+#endif
+
+  // Relabels part (collective) so that the largest overlaps with the current owners keep their rank, as a
+  // partitioner without a notion of the current partition would otherwise move almost everything
+  static void relabel(const Graph& graph, std::vector<idx_t>& part, idx_t nparts, MPI_Comm comm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    // Row of the overlap matrix: load of this rank's vertices per new label
+    std::vector<double> row(nparts, 0);
+    for (idx_t i = 0; i < graph.numVertices(); ++i)
+      row[part[i]] += graph.weighted() ? graph.vwgt[i*graph.ncon] : 1;
+
+    // With more parts than ranks, the surplus labels go to empty rows, i.e. to labels beyond the ranks
+    const int rows = std::max<int>(size, nparts);
+
+    std::vector<double> overlap(rank == 0 ? rows*nparts : 0, 0);
+    MPI_Gather(row.data(), nparts, MPI_DOUBLE, overlap.data(), nparts, MPI_DOUBLE, 0, comm);
+
+    std::vector<int> target(nparts);
+    if (0 == rank)
+      LabelAssignment::assign(overlap, rows, nparts, LabelAssignment::Greedy, target);
+
+    MPI_Bcast(target.data(), nparts, MPI_INT, 0, comm);
+
+    for (idx_t i = 0; i < graph.numVertices(); ++i)
+      part[i] = target[part[i]];
+  }
+};
+
+#endif
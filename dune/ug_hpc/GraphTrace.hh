@@ -0,0 +1,147 @@
+#ifndef GRAPHTRACE_H
+#define GRAPHTRACE_H
+
+#include <dune/common/exceptions.hh>
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include <dune/ug_hpc/GlobalUniqueIndex.hh>
+#include <dune/ug_hpc/Parmetisgridpartitioner.hh>
+#include <dune/ug_hpc/PartitionConstraints.hh>
+
+
+// One rank's share of the distributed dual graph of one step, as handed to ParMETIS, together with the rank that
+// currently owns each vertex.  Traces are written to one binary file per rank and step, so that partitioners can
+// be benchmarked on recorded grid states without running the adaptation loop.  All arrays are stored as 64 bit
+// integers, independent of the idx_t ParMETIS was built with.
+struct GraphTrace {
+#if PARMETIS_MAJOR_VERSION < 4
+  typedef idxtype idx_t;
+#endif
+
+  int32_t rank;                  // rank that wrote the trace
+  int32_t size;                  // number of ranks
+  int32_t step;                  // step of the adaptation loop
+  int32_t ncon;                  // number of vertex weights, 0 if unweighted
+  std::vector<int64_t> vtxdist;  // distribution of the vertices over the ranks
+  std::vector<int64_t> xadj;     // local CSR row pointers
+  std::vector<int64_t> adjncy;   // global indices of the neighbors
+  std::vector<int64_t> vwgt;     // ncon weights per vertex
+  std::vector<int64_t> owner;    // rank that owns each vertex
+
+
+  GraphTrace() : rank(0), size(1), step(0), ncon(0) {}
+
+  // Collective: records the dual graph of the interior leaf elements of gv
+  template<class GridView>
+  static GraphTrace capture(const GridView& gv, int step,
+			    const PartitionConstraints<GridView>& constraints = PartitionConstraints<GridView>()) {
+    typedef ParMetisGridPartitioner<GridView> Partitioner;
+
+    GlobalUniqueIndex<GridView> globalIndex(gv);
+
+    std::vector<idx_t> xadj, adjncy, vwgt;
+    Partitioner::buildGraph(gv, globalIndex, constraints, xadj, adjncy, vwgt);
+
+    GraphTrace trace;
+    trace.rank = gv.comm().rank();
+    trace.size = gv.comm().size();
+    trace.step = step;
+    trace.ncon = constraints.weighted() ? constraints.ncon() : 0;
+
+    const std::vector<int>& vtxdist = globalIndex.indexOffset();
+    trace.vtxdist.assign(vtxdist.begin(), vtxdist.end());
+    trace.xadj.assign(xadj.begin(), xadj.end());
+    trace.adjncy.assign(adjncy.begin(), adjncy.end());
+    trace.vwgt.assign(vwgt.begin(), vwgt.end());
+    trace.owner.assign(xadj.size() - 1, trace.rank);
+
+    return trace;
+  }
+
+  static std::string fileName(const std::string& prefix, int step, int rank) {
+    std::ostringstream name;
+    name << prefix << "_step" << step << "_rank" << rank << ".bin";
+
+    return name.str();
+  }
+
+  size_t numVertices() const {
+    return xadj.empty() ? 0 : xadj.size() - 1;
+  }
+
+  void write(const std::string& prefix) const {
+    const std::string name = fileName(prefix, step, rank);
+    std::ofstream out(name.c_str(), std::ios::binary);
+
+    if (!out)
+      DUNE_THROW(Dune::IOError, "Could not open " << name << " for writing.");
+
+    out.write(magic(), 8);
+
+    const int32_t header[4] = {rank, size, step, ncon};
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    writeArray(out, vtxdist);
+    writeArray(out, xadj);
+    writeArray(out, adjncy);
+    writeArray(out, vwgt);
+    writeArray(out, owner);
+  }
+
+  static GraphTrace read(const std::string& prefix, int step, int rank) {
+    const std::string name = fileName(prefix, step, rank);
+    std::ifstream in(name.c_str(), std::ios::binary);
+
+    char m[8];
+    if (!in || !in.read(m, 8) || std::memcmp(m, magic(), 8) != 0)
+      DUNE_THROW(Dune::IOError, name << " is not a graph trace.");
+
+    GraphTrace trace;
+
+    int32_t header[4];
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    trace.rank = header[0];
+    trace.size = header[1];
+    trace.step = header[2];
+    trace.ncon = header[3];
+
+    readArray(in, trace.vtxdist);
+    readArray(in, trace.xadj);
+    readArray(in, trace.adjncy);
+    readArray(in, trace.vwgt);
+    readArray(in, trace.owner);
+
+    if (!in)
+      DUNE_THROW(Dune::IOError, name << " is truncated.");
+
+    return trace;
+  }
+
+private:
+  static const char* magic() {
+    return "UGHPCGT1";
+  }
+
+  static void writeArray(std::ofstream& out, const std::vector<int64_t>& a) {
+    const int64_t n = a.size();
+    out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+    out.write(reinterpret_cast<const char*>(a.data()), n*sizeof(int64_t));
+  }
+
+  static void readArray(std::ifstream& in, std::vector<int64_t>& a) {
+    int64_t n = 0;
+    in.read(reinterpret_cast<char*>(&n), sizeof(n));
+
+    a.resize(in ? n : 0);
+    in.read(reinterpret_cast<char*>(a.data()), a.size()*sizeof(int64_t));
+  }
+};
+
+#endif
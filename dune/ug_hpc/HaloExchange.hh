@@ -0,0 +1,461 @@
+#ifndef HALOEXCHANGE_H
+#define HALOEXCHANGE_H
+
+#include <dune/common/exceptions.hh>
+#include <dune/common/parallel/mpihelper.hh>
+#include <dune/geometry/type.hh>
+#include <dune/grid/common/datahandleif.hh>
+#include <dune/grid/common/gridenums.hh>
+#include <dune/grid/common/mcmgmapper.hh>
+
+#include <algorithm>
+#include <climits>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <mpi.h>
+
+
+// Halo exchange of per-entity arrays of one codimension (elements: 0, vertices: dimension) without per-entity
+// callbacks.  update() finds the owner of every entity shared with other ranks, the interior copy or for border
+// entities the one on the lowest rank, and derives the neighbor ranks and the index lists to send and receive
+// with one gv.communicate; both sides sort the lists by global id, so they match without further messages.
+// An exchange then copies the owners' values to all other copies: it packs the send lists into one contiguous
+// buffer, transfers it with
+//   PersistentRequests  MPI_Send_init / MPI_Recv_init per neighbor, set up once and started by every exchange
+//   NeighborCollective  MPI_Ineighbor_alltoallv on a graph communicator of the neighbors (MPI 3), a persistent
+//                       MPI_Neighbor_alltoallv_init with MPI 4
+//   Communicate         gv.communicate with a data handle, for comparison
+// and unpacks the receive buffer.  Ranks without shared entities, e.g. the ones left idle by an elastic part
+// count, have no neighbors and take no part.
+//
+// The arrays are indexed like a MultipleCodimMultipleGeomTypeMapper with MCMGElementLayout (codim 0) or
+// MCMGVertexLayout (codim dimension), T has to be trivially copyable.  Call update() after every loadBalance
+// and adapt, as the mapper indices change with the grid.
+//
+//   HaloExchange<GridView> halo(gv);
+//   for (...) { compute(u); halo.exchange(u); }
+//   grid.loadBalance(part, 0);
+//   halo.update();
+template<class GridView, int codim = 0>
+class HaloExchange {
+public:
+  typedef typename GridView::template Codim<codim>::Iterator Iterator;
+  typedef typename GridView::template Codim<codim>::Entity   Entity;
+
+  typedef typename GridView::Grid::GlobalIdSet         GlobalIdSet;
+  typedef typename GridView::Grid::GlobalIdSet::IdType IdType;
+
+  enum {
+    dimension = GridView::dimension
+  };
+
+  // The entities of codimension codim
+  template<int dim>
+  struct Layout {
+    bool contains(Dune::GeometryType gt) const {
+      return gt.dim() == dim - codim;
+    }
+  };
+
+  typedef Dune::MultipleCodimMultipleGeomTypeMapper<GridView, Layout> Mapper;
+
+  enum Method {
+    Communicate,
+    PersistentRequests,
+    NeighborCollective
+  };
+
+  static Method method(const std::string& name) {
+    Method m;
+    if (name == "communicate")
+      m = Communicate;
+    else if (name == "persistent")
+      m = PersistentRequests;
+    else if (name == "neighbor")
+      m = NeighborCollective;
+    else
+      DUNE_THROW(Dune::Exception, "Unknown halo exchange method " << name << ".");
+
+    if (!available(m))
+      DUNE_THROW(Dune::NotImplemented, "Neighbor collectives need MPI 3 or newer.");
+
+    return m;
+  }
+
+  static bool available(Method m) {
+#if MPI_VERSION < 3
+    if (m == NeighborCollective)
+      return false;
+#endif
+
+    return true;
+  }
+
+private:
+  // Sends the rank of every copy and whether it may own the entity to all other copies
+  class CopyExchange : public Dune::CommDataHandleIF<CopyExchange, int> {
+  public:
+    bool contains (int dim, int cd) const {
+      return codim == cd;
+    }
+
+    bool fixedsize (int dim, int cd) const {
+      return true;
+    }
+
+    template<class EntityType>
+    size_t size (EntityType& e) const {
+      return 2;
+    }
+
+    template<class MessageBuffer, class EntityType>
+    void gather (MessageBuffer& buff, const EntityType& e) const {
+      buff.write(rank_);
+      buff.write(candidate(e) ? 1 : 0);
+    }
+
+    template<class MessageBuffer, class EntityType>
+    void scatter (MessageBuffer& buff, const EntityType& e, size_t n) {
+      int r, c;
+      buff.read(r);
+      buff.read(c);
+
+      copies_[mapper_.map(e)].push_back(std::make_pair(r, c != 0));
+    }
+
+    CopyExchange (const Mapper& mapper, std::vector<std::vector<std::pair<int, bool> > >& copies, int rank) :
+      mapper_(mapper),
+      copies_(copies),
+      rank_(rank)
+    {}
+
+  private:
+    const Mapper& mapper_;
+    std::vector<std::vector<std::pair<int, bool> > >& copies_;
+    int rank_;
+  };
+
+  // Copies the owners' values to the other copies, for the Communicate method
+  template<class T>
+  class ValueExchange : public Dune::CommDataHandleIF<ValueExchange<T>, T> {
+  public:
+    bool contains (int dim, int cd) const {
+      return codim == cd;
+    }
+
+    bool fixedsize (int dim, int cd) const {
+      return false;
+    }
+
+    template<class EntityType>
+    size_t size (EntityType& e) const {
+      return (owner_[mapper_.map(e)] == rank_) ? 1 : 0;
+    }
+
+    template<class MessageBuffer, class EntityType>
+    void gather (MessageBuffer& buff, const EntityType& e) const {
+      const int i = mapper_.map(e);
+      if (owner_[i] == rank_)
+	buff.write(data_[i]);
+    }
+
+    template<class MessageBuffer, class EntityType>
+    void scatter (MessageBuffer& buff, const EntityType& e, size_t n) {
+      if (1 == n)
+	buff.read(data_[mapper_.map(e)]);
+    }
+
+    ValueExchange (const Mapper& mapper, const std::vector<int>& owner, int rank, std::vector<T>& data) :
+      mapper_(mapper),
+      owner_(owner),
+      rank_(rank),
+      data_(data)
+    {}
+
+  private:
+    const Mapper& mapper_;
+    const std::vector<int>& owner_;
+    int rank_;
+    std::vector<T>& data_;
+  };
+
+public:
+  // Collective: sets up the index lists of the current grid
+  explicit HaloExchange(const GridView& gv, Method method = PersistentRequests) :
+    gv_(gv), mapper_(gv_), method_(method), rank_(gv_.comm().rank()), graphComm_(MPI_COMM_NULL), bytes_(0)
+  {
+    if (!available(method_))
+      DUNE_THROW(Dune::NotImplemented, "Neighbor collectives need MPI 3 or newer.");
+
+    MPI_Comm_dup(Dune::MPIHelper::getCommunicator(), &comm_);
+    update();
+  }
+
+  ~HaloExchange() {
+    release();
+    MPI_Comm_free(&comm_);
+  }
+
+  // Collective: recomputes the owners, the neighbors and the index lists after the grid has changed
+  void update() {
+    release();
+    mapper_.update();
+
+    // Ranks of all other copies of every entity
+    std::vector<std::vector<std::pair<int, bool> > > copies(mapper_.size());
+    CopyExchange dh(mapper_, copies, rank_);
+    gv_.communicate(dh, Dune::All_All_Interface, Dune::ForwardCommunication);
+
+    // Global id and index of the entities to send to and receive from every neighbor
+    typedef std::vector<std::pair<IdType, int> > List;
+    std::map<int, List> send, receive;
+
+    const GlobalIdSet& globalIdSet = gv_.grid().globalIdSet();
+    owner_.assign(mapper_.size(), rank_);
+
+    for (Iterator it = gv_.template begin<codim>(); it != gv_.template end<codim>(); ++it) {
+      const int i = mapper_.map(*it);
+      if (copies[i].empty())
+	continue;
+
+      int owner = candidate(*it) ? rank_ : INT_MAX;
+      for (size_t k = 0; k < copies[i].size(); ++k)
+	if (copies[i][k].second)
+	  owner = std::min(owner, copies[i][k].first);
+
+      // A ghost whose owner shares no interface with this rank keeps its value
+      if (owner == INT_MAX)
+	continue;
+
+      owner_[i] = owner;
+      const std::pair<IdType, int> entry(globalIdSet.id(*it), i);
+
+      if (owner == rank_)
+	for (size_t k = 0; k < copies[i].size(); ++k)
+	  send[copies[i][k].first].push_back(entry);
+      else
+	receive[owner].push_back(entry);
+    }
+
+    flatten(send, destinations_, sendOffset_, sendIndex_);
+    flatten(receive, sources_, receiveOffset_, receiveIndex_);
+
+#if MPI_VERSION >= 3
+    if (method_ == NeighborCollective)
+      MPI_Dist_graph_create_adjacent(comm_, sources_.size(), sources_.data(), MPI_UNWEIGHTED,
+				     destinations_.size(), destinations_.data(), MPI_UNWEIGHTED,
+				     MPI_INFO_NULL, 0, &graphComm_);
+#endif
+  }
+
+  // Collective: copies the owners' values of data to all other copies
+  template<class T>
+  void exchange(std::vector<T>& data) {
+    start(data);
+    finish(data);
+  }
+
+  // Starts an exchange, which finish completes; the owned entries of data must not change in between, so the
+  // transfer can overlap with work on the interior
+  template<class T>
+  void start(std::vector<T>& data) {
+    if (method_ == Communicate) {
+      ValueExchange<T> dh(mapper_, owner_, rank_, data);
+      gv_.communicate(dh, Dune::InteriorBorder_All_Interface, Dune::ForwardCommunication);
+      return;
+    }
+
+    setup(sizeof(T));
+
+    if (method_ == PersistentRequests && !receiveRequests_.empty())
+      MPI_Startall(receiveRequests_.size(), receiveRequests_.data());
+
+    T* buffer = reinterpret_cast<T*>(sendBuffer_.data());
+    for (size_t k = 0; k < sendIndex_.size(); ++k)
+      buffer[k] = data[sendIndex_[k]];
+
+    if (method_ == PersistentRequests) {
+      if (!sendRequests_.empty())
+	MPI_Startall(sendRequests_.size(), sendRequests_.data());
+    }
+    else {
+#if MPI_VERSION >= 4
+      MPI_Start(&neighborRequest_);
+#elif MPI_VERSION >= 3
+      MPI_Ineighbor_alltoallv(sendBuffer_.data(), sendCounts_.data(), sendDispls_.data(), MPI_BYTE,
+			      receiveBuffer_.data(), receiveCounts_.data(), receiveDispls_.data(), MPI_BYTE,
+			      graphComm_, &neighborRequest_);
+#endif
+    }
+  }
+
+  template<class T>
+  void finish(std::vector<T>& data) {
+    if (method_ == Communicate)
+      return;
+
+    if (method_ == PersistentRequests) {
+      MPI_Waitall(receiveRequests_.size(), receiveRequests_.data(), MPI_STATUSES_IGNORE);
+      MPI_Waitall(sendRequests_.size(), sendRequests_.data(), MPI_STATUSES_IGNORE);
+    }
+    else
+      MPI_Wait(&neighborRequest_, MPI_STATUS_IGNORE);
+
+    const T* buffer = reinterpret_cast<const T*>(receiveBuffer_.data());
+    for (size_t k = 0; k < receiveIndex_.size(); ++k)
+      data[receiveIndex_[k]] = buffer[k];
+  }
+
+  Method method() const {
+    return method_;
+  }
+
+  const Mapper& mapper() const {
+    return mapper_;
+  }
+
+  // Rank that owns entity i, this rank for entities that are not shared
+  int owner(int i) const {
+    return owner_[i];
+  }
+
+  // Ranks sent to and received from, and the number of entities sent and received per exchange
+  const std::vector<int>& destinations() const {
+    return destinations_;
+  }
+
+  const std::vector<int>& sources() const {
+    return sources_;
+  }
+
+  size_t sendSize() const {
+    return sendIndex_.size();
+  }
+
+  size_t receiveSize() const {
+    return receiveIndex_.size();
+  }
+
+private:
+  enum {
+    tag = 5731
+  };
+
+  // Interior and border entities can own their value, ghosts cannot
+  template<class EntityType>
+  static bool candidate(const EntityType& e) {
+    return e.partitionType() == Dune::InteriorEntity || e.partitionType() == Dune::BorderEntity;
+  }
+
+  // Ranks in ascending order, the offset of every rank's list, and the concatenated indices sorted by global id
+  template<class List>
+  static void flatten(std::map<int, List>& lists, std::vector<int>& ranks, std::vector<int>& offset, std::vector<int>& index) {
+    ranks.clear();
+    offset.assign(1, 0);
+    index.clear();
+
+    for (typename std::map<int, List>::iterator it = lists.begin(); it != lists.end(); ++it) {
+      std::sort(it->second.begin(), it->second.end());
+
+      ranks.push_back(it->first);
+      for (size_t k = 0; k < it->second.size(); ++k)
+	index.push_back(it->second[k].second);
+      offset.push_back(index.size());
+    }
+  }
+
+  // Buffers, counts and requests for entries of the given size; kept until the size or the grid changes
+  void setup(size_t bytes) {
+    if (bytes == bytes_)
+      return;
+
+    freeRequests();
+    bytes_ = bytes;
+
+    sendBuffer_.resize(sendIndex_.size() * bytes);
+    receiveBuffer_.resize(receiveIndex_.size() * bytes);
+
+    counts(sendOffset_, bytes, sendCounts_, sendDispls_);
+    counts(receiveOffset_, bytes, receiveCounts_, receiveDispls_);
+
+    if (method_ == PersistentRequests) {
+      receiveRequests_.resize(sources_.size());
+      for (size_t q = 0; q < sources_.size(); ++q)
+	MPI_Recv_init(receiveBuffer_.data() + receiveDispls_[q], receiveCounts_[q], MPI_BYTE, sources_[q], tag, comm_,
+		      &receiveRequests_[q]);
+
+      sendRequests_.resize(destinations_.size());
+      for (size_t q = 0; q < destinations_.size(); ++q)
+	MPI_Send_init(sendBuffer_.data() + sendDispls_[q], sendCounts_[q], MPI_BYTE, destinations_[q], tag, comm_,
+		      &sendRequests_[q]);
+    }
+
+#if MPI_VERSION >= 4
+    if (method_ == NeighborCollective)
+      MPI_Neighbor_alltoallv_init(sendBuffer_.data(), sendCounts_.data(), sendDispls_.data(), MPI_BYTE,
+				  receiveBuffer_.data(), receiveCounts_.data(), receiveDispls_.data(), MPI_BYTE,
+				  graphComm_, MPI_INFO_NULL, &neighborRequest_);
+#endif
+  }
+
+  static void counts(const std::vector<int>& offset, size_t bytes, std::vector<int>& count, std::vector<int>& displ) {
+    count.resize(offset.size() - 1);
+    displ.resize(offset.size() - 1);
+
+    for (size_t q = 0; q + 1 < offset.size(); ++q) {
+      count[q] = (offset[q+1] - offset[q]) * bytes;
+      displ[q] = offset[q] * bytes;
+    }
+  }
+
+  void freeRequests() {
+    for (size_t q = 0; q < receiveRequests_.size(); ++q)
+      MPI_Request_free(&receiveRequests_[q]);
+    for (size_t q = 0; q < sendRequests_.size(); ++q)
+      MPI_Request_free(&sendRequests_[q]);
+
+    receiveRequests_.clear();
+    sendRequests_.clear();
+
+#if MPI_VERSION >= 4
+    if (method_ == NeighborCollective && bytes_ > 0)
+      MPI_Request_free(&neighborRequest_);
+#endif
+
+    bytes_ = 0;
+  }
+
+  void release() {
+    freeRequests();
+
+    if (graphComm_ != MPI_COMM_NULL)
+      MPI_Comm_free(&graphComm_);
+  }
+
+  // Not copyable, the requests point into the buffers
+  HaloExchange(const HaloExchange&);
+  HaloExchange& operator=(const HaloExchange&);
+
+  const GridView gv_;
+  Mapper mapper_;
+  Method method_;
+  int rank_;
+
+  MPI_Comm comm_, graphComm_;
+  std::vector<int> owner_;
+
+  // Neighbors in ascending rank order; the entries of neighbor q are index[offset[q]], ..., index[offset[q+1]-1]
+  std::vector<int> destinations_, sendOffset_, sendIndex_;
+  std::vector<int> sources_, receiveOffset_, receiveIndex_;
+
+  size_t bytes_;  // entry size the buffers and requests are set up for, 0 if none
+  std::vector<char> sendBuffer_, receiveBuffer_;
+  std::vector<int> sendCounts_, sendDispls_, receiveCounts_, receiveDispls_;
+  std::vector<MPI_Request> sendRequests_, receiveRequests_;
+  MPI_Request neighborRequest_;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef ITRCONTROLLER_H
+#define ITRCONTROLLER_H
+
+#include <algorithm>
+#include <vector>
+
+#include <parmetis.h>
+
+#include <dune/ug_hpc/DiffusionBenchmark.hh>
+
+
+// Derives the itr parameter of ParMETIS_V3_AdaptiveRepart from measured costs.  AdaptiveRepart minimizes
+// itr * |edgecut| + |moved vertices|, so itr should be the cost of one cut edge over the time until the next
+// repartition divided by the cost of moving one element.  The first is the halo exchange time per boundary
+// face times the number of solver iterations per step, the second the loadBalance time per migrated element.
+// Both are estimated from every step's measurements and smoothed exponentially.
+template<class GridView>
+class ItrController {
+public:
+#if PARMETIS_MAJOR_VERSION < 4
+  typedef float real_t;
+#endif
+
+  typedef typename GridView::template Codim<0>::template Partition<Dune::Interior_Partition>::Iterator InteriorElementIterator;
+  typedef typename GridView::IntersectionIterator                                                      IntersectionIterator;
+
+  typedef Dune::MultipleCodimMultipleGeomTypeMapper<GridView, Dune::MCMGElementLayout> ElementMapper;
+
+  // iterationsPerStep: halo exchanges of the solver between two repartitions.
+  // smoothing: weight of the newest measurement in the estimates.
+  ItrController(real_t initial = 1000, double iterationsPerStep = 100, double smoothing = 0.5) :
+    itr_(initial), iterationsPerStep_(iterationsPerStep), smoothing_(smoothing), edgeCost_(-1), moveCost_(-1)
+  {}
+
+  real_t itr() const {
+    return itr_;
+  }
+
+  // Seconds per cut face and halo exchange, negative before the first measurement
+  double edgeCost() const {
+    return edgeCost_;
+  }
+
+  // Seconds per migrated element, negative before the first measurement
+  double moveCost() const {
+    return moveCost_;
+  }
+
+  // Number of interior elements of this rank that part sends elsewhere.  Call before loadBalance(part, 0).
+  static double localMigratedElements(const GridView& gv, const std::vector<unsigned>& part) {
+    const unsigned rank = gv.comm().rank();
+    ElementMapper elementMapper(gv);
+
+    double moved = 0;
+    for (InteriorElementIterator eIt = gv.template begin<0, Dune::Interior_Partition>(); eIt != gv.template end<0, Dune::Interior_Partition>(); ++eIt)
+      if (part[elementMapper.map(*eIt)] != rank)
+	++moved;
+
+    return moved;
+  }
+
+  // Collective: localMigratedElements maximized over the ranks
+  static double migratedElements(const GridView& gv, const std::vector<unsigned>& part) {
+    return gv.comm().max(localMigratedElements(gv, part));
+  }
+
+  // Collective: records the time of a loadBalance that migrated the given number of elements
+  void observeMigration(const GridView& gv, double migrated, double time) {
+    time = gv.comm().max(time);
+
+    if (migrated > 0)
+      moveCost_ = smooth(moveCost_, time / migrated);
+  }
+
+  // Collective: records the time of one halo exchange on the current partition
+  void observeCommunication(const GridView& gv, double timePerExchange) {
+    const double faces = gv.comm().max(cutFaces(gv));
+    timePerExchange = gv.comm().max(timePerExchange);
+
+    if (faces > 0)
+      edgeCost_ = smooth(edgeCost_, timePerExchange / faces);
+  }
+
+  // Collective: times the given number of halo exchanges on the current partition
+  void probeCommunication(const GridView& gv, int exchanges = 5) {
+    DiffusionBenchmark<GridView> probe(gv);
+    observeCommunication(gv, probe.run(exchanges).communicationPerIteration());
+  }
+
+  // Recomputes itr from the current estimates, clamped to the range ParMETIS accepts
+  real_t update() {
+    if (edgeCost_ > 0 && moveCost_ > 0)
+      itr_ = std::min(std::max(iterationsPerStep_ * edgeCost_ / moveCost_, 1e-6), 1e6);
+
+    return itr_;
+  }
+
+private:
+  // Faces between interior elements of this rank and elements of other ranks
+  static double cutFaces(const GridView& gv) {
+    double faces = 0;
+
+    for (InteriorElementIterator eIt = gv.template begin<0, Dune::Interior_Partition>(); eIt != gv.template end<0, Dune::Interior_Partition>(); ++eIt)
+      for (IntersectionIterator iIt = gv.ibegin(*eIt); iIt != gv.iend(*eIt); ++iIt)
+	if (iIt->neighbor() && iIt->outside()->partitionType() != Dune::InteriorEntity)
+	  ++faces;
+
+    return faces;
+  }
+
+  double smooth(double estimate, double measurement) const {
+    return (estimate < 0) ? measurement : smoothing_ * measurement + (1 - smoothing_) * estimate;
+  }
+
+  real_t itr_;
+  double iterationsPerStep_, smoothing_;
+  double edgeCost_, moveCost_;
+};
+
+#endif
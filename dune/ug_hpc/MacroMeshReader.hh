@@ -0,0 +1,311 @@
+#ifndef MACROMESHREADER_H
+#define MACROMESHREADER_H
+
+#include <dune/common/exceptions.hh>
+#include <dune/common/fvector.hh>
+#include <dune/common/parallel/mpihelper.hh>
+#include <dune/common/shared_ptr.hh>
+#include <dune/geometry/type.hh>
+#include <dune/grid/common/gridfactory.hh>
+#include <dune/grid/common/mcmgmapper.hh>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include <mpi.h>
+
+#include <parmetis.h>
+
+#include <dune/ug_hpc/ElasticPartCount.hh>
+
+
+// Compact binary macro mesh of a single element type, in native byte order:
+//   header    MacroMeshFormat::Header
+//   vertices  numVertices * dimension doubles
+//   elements  numElements * cornersPerElement int64 vertex numbers, starting at 0, in Dune corner numbering
+// All records have a fixed size, so every rank can compute the byte range of its share of the elements.
+struct MacroMeshFormat {
+  struct Header {
+    char magic[8];
+    int32_t version;
+    int32_t dimension;
+    int32_t cornersPerElement; // dimension+1 for simplices, 2^dimension for cubes
+    int32_t reserved;
+    int64_t numVertices;
+    int64_t numElements;
+  };
+
+  static const int32_t currentVersion = 1;
+
+  static Header header(int dimension, int cornersPerElement, int64_t numVertices, int64_t numElements) {
+    Header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, "DUGHMESH", 8);
+    h.version = currentVersion;
+    h.dimension = dimension;
+    h.cornersPerElement = cornersPerElement;
+    h.numVertices = numVertices;
+    h.numElements = numElements;
+
+    return h;
+  }
+
+  static void check(const Header& h, const std::string& fileName) {
+    if (std::memcmp(h.magic, "DUGHMESH", 8) != 0)
+      DUNE_THROW(Dune::IOError, fileName << " is not a binary macro mesh.");
+    if (h.version != currentVersion)
+      DUNE_THROW(Dune::IOError, fileName << " has version " << h.version << ", expected " << currentVersion << ".");
+  }
+
+  static MPI_Offset vertexOffset(const Header& h, int64_t vertex) {
+    return sizeof(Header) + vertex * h.dimension * sizeof(double);
+  }
+
+  static MPI_Offset elementOffset(const Header& h, int64_t element) {
+    return vertexOffset(h, h.numVertices) + element * h.cornersPerElement * sizeof(int64_t);
+  }
+
+  // Writes a whole mesh (serial)
+  static void write(const std::string& fileName, int dimension, int cornersPerElement,
+		    const std::vector<double>& vertices, const std::vector<int64_t>& elements) {
+    std::ofstream out(fileName.c_str(), std::ios::binary);
+    if (!out)
+      DUNE_THROW(Dune::IOError, "Could not open " << fileName << " for writing.");
+
+    const Header h = header(dimension, cornersPerElement, vertices.size() / dimension, elements.size() / cornersPerElement);
+
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    out.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(double));
+    out.write(reinterpret_cast<const char*>(elements.data()), elements.size() * sizeof(int64_t));
+
+    if (!out)
+      DUNE_THROW(Dune::IOError, "Could not write " << fileName << ".");
+  }
+};
+
+
+// Parallel reader for the binary macro mesh.  Every rank reads only its contiguous share of the elements with
+// MPI-IO and the ranks partition the distributed element slices with ParMETIS_V3_PartMeshKway, so the
+// partitioning of large meshes does not run on a single rank.
+//
+// UG builds the macro grid on rank 0, so the elements still have to be inserted into the grid factory there:
+// rank 0 streams the vertices, gathers the elements in file order and creates the grid, the other ranks only
+// take part in the collective createGrid.  The returned part sends every element to its rank with
+// grid.loadBalance(part, 0).
+template<class Grid>
+class MacroMeshReader {
+public:
+#if PARMETIS_MAJOR_VERSION < 4
+  typedef idxtype idx_t;
+  typedef float real_t;
+#endif
+
+  typedef typename Grid::LeafGridView GridView;
+
+  typedef typename GridView::template Codim<0>::Iterator ElementIterator;
+
+  typedef Dune::MultipleCodimMultipleGeomTypeMapper<GridView, Dune::MCMGElementLayout> ElementMapper;
+
+  enum {
+    dimension = Grid::dimension
+  };
+
+  // Collective: reads fileName and returns the grid, and in part the target rank of every leaf element.  The
+  // elements go to partCount.parts of the ranks, all of them by default.
+  static Dune::shared_ptr<Grid> read(const std::string& fileName, std::vector<unsigned>& part,
+				     const ElasticPartCount& partCount = ElasticPartCount()) {
+    MPI_Comm comm = Dune::MPIHelper::getCommunicator();
+
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    MPI_File file;
+    if (MPI_File_open(comm, const_cast<char*>(fileName.c_str()), MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS)
+      DUNE_THROW(Dune::IOError, "Could not open " << fileName << ".");
+
+    MacroMeshFormat::Header header;
+    readAt(file, 0, &header, sizeof(header));
+    MacroMeshFormat::check(header, fileName);
+
+    if (header.dimension != dimension)
+      DUNE_THROW(Dune::IOError, fileName << " is a " << header.dimension << "d mesh, expected " << dimension << "d.");
+
+    const int corners = header.cornersPerElement;
+
+    Dune::GeometryType type;
+    if (corners == dimension + 1)
+      type.makeSimplex(dimension);
+    else if (corners == (1 << dimension))
+      type.makeCube(dimension);
+    else
+      DUNE_THROW(Dune::IOError, fileName << " has elements with " << corners << " corners.");
+
+    // The gathers below count and place whole elements with int, as do ParMETIS' indices with 32 bit idx_t
+    if (header.numElements > std::numeric_limits<int>::max() || header.numElements > std::numeric_limits<idx_t>::max())
+      DUNE_THROW(Dune::IOError, fileName << " has " << header.numElements << " elements, more than the reader can gather.");
+
+    // This rank's slice of the elements
+    std::vector<idx_t> elmdist(size + 1);
+    for (int r = 0; r <= size; ++r)
+      elmdist[r] = header.numElements * r / size;
+
+    const int64_t first = elmdist[rank];
+    const int64_t numLocal = elmdist[rank+1] - first;
+
+    std::vector<int64_t> elements(numLocal * corners);
+    readAt(file, MacroMeshFormat::elementOffset(header, first), elements.data(), elements.size() * sizeof(int64_t));
+
+    // Partition the distributed slices
+    std::vector<idx_t> slicePart(numLocal, rank);
+    partition(elmdist, elements, corners, partCount.parts(header.numElements, size), slicePart, comm);
+
+    // Gather the elements and their parts in file order on rank 0
+    std::vector<int> counts(size), displs(size);
+    for (int r = 0; r < size; ++r) {
+      counts[r] = elmdist[r+1] - elmdist[r];
+      displs[r] = elmdist[r];
+    }
+
+    std::vector<int> localPart(slicePart.begin(), slicePart.end());
+    std::vector<int> filePart(rank == 0 ? header.numElements : 0);
+    MPI_Gatherv(localPart.data(), numLocal, MPI_INT, filePart.data(), counts.data(), displs.data(), MPI_INT, 0, comm);
+
+    // One element of corners vertex numbers per datatype item, so the counts and displacements stay element
+    // counts instead of overflowing int with the vertex numbers
+    MPI_Datatype elementType;
+    MPI_Type_contiguous(corners, MPI_INT64_T, &elementType);
+    MPI_Type_commit(&elementType);
+
+    std::vector<int64_t> allElements(rank == 0 ? header.numElements * corners : 0);
+    MPI_Gatherv(elements.data(), numLocal, elementType, allElements.data(), counts.data(), displs.data(),
+		elementType, 0, comm);
+
+    MPI_Type_free(&elementType);
+
+    elements.clear();
+
+    // Build the macro grid on rank 0
+    Dune::GridFactory<Grid> factory;
+
+    if (0 == rank) {
+      const int64_t chunk = 1 << 20;
+      std::vector<double> coordinates;
+
+      for (int64_t v = 0; v < header.numVertices; v += chunk) {
+	const int64_t n = std::min(chunk, header.numVertices - v);
+	coordinates.resize(n * dimension);
+	readAt(file, MacroMeshFormat::vertexOffset(header, v), coordinates.data(), coordinates.size() * sizeof(double));
+
+	for (int64_t i = 0; i < n; ++i) {
+	  Dune::FieldVector<typename Grid::ctype, dimension> x;
+	  for (int j = 0; j < dimension; ++j)
+	    x[j] = coordinates[i*dimension + j];
+
+	  factory.insertVertex(x);
+	}
+      }
+
+      std::vector<unsigned> vertices(corners);
+      for (int64_t e = 0; e < header.numElements; ++e) {
+	for (int k = 0; k < corners; ++k)
+	  vertices[k] = allElements[e*corners + k];
+
+	factory.insertElement(type, vertices);
+      }
+    }
+
+    MPI_File_close(&file);
+    allElements.clear();
+
+    Dune::shared_ptr<Grid> grid(factory.createGrid());
+
+    // Parts in the element order of the leaf grid view, the insertion index is the element's number in the file
+    const GridView gv = grid->leafGridView();
+    ElementMapper elementMapper(gv);
+
+    part.assign(gv.size(0), 0);
+    if (0 == rank)
+      for (ElementIterator eIt = gv.template begin<0>(); eIt != gv.template end<0>(); ++eIt)
+	part[elementMapper.map(*eIt)] = filePart[factory.insertionIndex(*eIt)];
+
+    return grid;
+  }
+
+private:
+  // Reads bytes at offset, in pieces that fit the int count of MPI
+  static void readAt(MPI_File file, MPI_Offset offset, void* buffer, size_t bytes) {
+    const size_t maxChunk = 1 << 30;
+    char* p = static_cast<char*>(buffer);
+
+    while (bytes > 0) {
+      const size_t n = std::min(bytes, maxChunk);
+
+      MPI_Status status;
+      if (MPI_File_read_at(file, offset, p, n, MPI_BYTE, &status) != MPI_SUCCESS)
+	DUNE_THROW(Dune::IOError, "Could not read the binary macro mesh.");
+
+      offset += n;
+      p += n;
+      bytes -= n;
+    }
+  }
+
+  // Collective: partitions the element slices into nparts parts, which are the ranks 0, ..., nparts-1.  ParMETIS
+  // rejects empty slices, so with fewer elements than ranks, as well as for a single part, the ranks 0, ...,
+  // nparts-1 get contiguous blocks of the file order instead.
+  static void partition(std::vector<idx_t>& elmdist, const std::vector<int64_t>& elements, int corners, int nparts,
+			std::vector<idx_t>& part, MPI_Comm comm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    bool emptySlice = false;
+    for (int r = 0; r < size; ++r)
+      emptySlice = emptySlice || (elmdist[r+1] == elmdist[r]);
+
+    if (nparts < 2 || emptySlice) {
+      const int64_t numElements = elmdist.back();
+      for (size_t i = 0; i < part.size(); ++i)
+	part[i] = (static_cast<int64_t>(elmdist[rank]) + i) * nparts / numElements;
+
+      return;
+    }
+
+    const idx_t numLocal = elements.size() / corners;
+
+    std::vector<idx_t> eptr(numLocal + 1), eind(elements.begin(), elements.end());
+    for (idx_t i = 0; i <= numLocal; ++i)
+      eptr[i] = i * corners;
+
+    idx_t wgtflag = 0;                                  // we don't use weights
+    idx_t numflag = 0;                                  // we are using C-style arrays
+    idx_t ncon = 1;                                     // number of balance constraints
+    idx_t ncommonnodes = dimension;                     // elements sharing a facet are adjacent
+    idx_t options[4] = {0, 0, 0, 0};                    // use default values for random seed, output and coupling
+    idx_t edgecut;                                      // will store number of edges cut by partition
+    idx_t n = nparts;
+    std::vector<real_t> tpwgts(ncon*nparts, 1./nparts); // same load on every process
+    std::vector<real_t> ubvec(ncon, 1.05);              // weight tolerance
+
+#if PARMETIS_MAJOR_VERSION >= 4
+    const int OK =
+#endif
+      ParMETIS_V3_PartMeshKway(elmdist.data(), eptr.data(), eind.data(), NULL, &wgtflag, &numflag,
+			       &ncon, &ncommonnodes, &n, tpwgts.data(), ubvec.data(),
+			       options, &edgecut, part.data(), &comm);
+
+#if PARMETIS_MAJOR_VERSION >= 4
+    if (OK != METIS_OK)
+      DUNE_THROW(Dune::Exception, "ParMETIS is not happy.");
+#endif
+  }
+};
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef MEMORYUSAGE_H
+#define MEMORYUSAGE_H
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+
+// Queries the memory consumption of the calling process (all values in kiB)
+struct MemoryUsage {
+  // Current resident set size, read from /proc/self/statm
+  static double residentSetSize() {
+    std::ifstream statm("/proc/self/statm");
+
+    long size = 0, resident = 0;
+    if (!(statm >> size >> resident))
+      return 0;
+
+    return resident * (sysconf(_SC_PAGESIZE) / 1024.);
+  }
+
+  // Peak resident set size since the process was started
+  static double highWaterMark() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+      return 0;
+
+    return usage.ru_maxrss; // Linux reports kiB
+  }
+
+  // Memory that can still be handed out on this node without swapping
+  static double availableMemory() {
+    return meminfo("MemAvailable:");
+  }
+
+  // Physical memory of this node
+  static double totalMemory() {
+    return meminfo("MemTotal:");
+  }
+
+private:
+  static double meminfo(const std::string& key) {
+    std::ifstream in("/proc/meminfo");
+
+    std::string name, unit;
+    double value;
+    while (in >> name >> value >> unit)
+      if (name == key)
+	return value;
+
+    return 0;
+  }
+};
+
+
+// Records memory samples after named phases of the program and reports per-rank extremes
+class MemoryStatistics {
+public:
+  struct Sample {
+    std::string phase;
+    double rss;       // resident set size after the phase
+    double hwm;       // high-water mark after the phase
+    double available; // memory still available on the node after the phase
+  };
+
+  // warnFraction: warn if less than this fraction of the node's memory is still available
+  explicit MemoryStatistics(double warnFraction = 0.1) : warnFraction_(warnFraction) {}
+
+  void sample(const std::string& phase) {
+    Sample s;
+    s.phase     = phase;
+    s.rss       = MemoryUsage::residentSetSize();
+    s.hwm       = MemoryUsage::highWaterMark();
+    s.available = MemoryUsage::availableMemory();
+
+    samples_.push_back(s);
+  }
+
+  const std::vector<Sample>& samples() const {
+    return samples_;
+  }
+
+  void clear() {
+    samples_.clear();
+  }
+
+  // Collective: every rank must have recorded the same phases in the same order
+  template<class CollectiveCommunication>
+  void report(const CollectiveCommunication& comm, std::ostream& out = std::cout) const {
+    const int size = comm.size();
+    const int numValues = 3*samples_.size();
+
+    if (0 == numValues)
+      return;
+
+    std::vector<double> local(numValues), all(numValues*size);
+    for (size_t i = 0; i < samples_.size(); ++i) {
+      local[3*i]   = samples_[i].rss;
+      local[3*i+1] = samples_[i].hwm;
+      local[3*i+2] = samples_[i].available;
+    }
+
+    comm.template allgather<double>(local.data(), numValues, all.data());
+
+    if (0 != comm.rank())
+      return;
+
+    const double total = MemoryUsage::totalMemory();
+    const double MiB = 1024.;
+
+    out << "Memory usage per phase in MiB (min / avg / max over ranks):" << std::endl;
+
+    for (size_t i = 0; i < samples_.size(); ++i) {
+      double minRss = all[3*i], maxRss = all[3*i], sumRss = 0, maxHwm = 0, minAvailable = all[3*i+2];
+      int maxRssRank = 0, maxHwmRank = 0;
+
+      for (int p = 0; p < size; ++p) {
+	const double rss = all[numValues*p + 3*i], hwm = all[numValues*p + 3*i+1], available = all[numValues*p + 3*i+2];
+
+	sumRss += rss;
+	minRss = std::min(minRss, rss);
+	minAvailable = std::min(minAvailable, available);
+
+	if (rss > maxRss) {
+	  maxRss = rss;
+	  maxRssRank = p;
+	}
+
+	if (hwm > maxHwm) {
+	  maxHwm = hwm;
+	  maxHwmRank = p;
+	}
+      }
+
+      out << "   " << std::left << std::setw(16) << samples_[i].phase << std::right << std::fixed << std::setprecision(1)
+	  << " rss " << minRss/MiB << " / " << sumRss/size/MiB << " / " << maxRss/MiB << " (rank " << maxRssRank << ")"
+	  << ", hwm " << maxHwm/MiB << " (rank " << maxHwmRank << ")" << std::endl;
+
+      if (total > 0 && minAvailable < warnFraction_*total)
+	out << "   Warning: only " << minAvailable/MiB << " MiB of " << total/MiB << " MiB left on some node after phase "
+	    << samples_[i].phase << std::endl;
+    }
+  }
+
+private:
+  double warnFraction_;
+  std::vector<Sample> samples_;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef NODETOPOLOGY_H
+#define NODETOPOLOGY_H
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+
+
+// Groups the ranks of a communicator by the compute node they run on, i.e. by shared memory domain.
+// Nodes are numbered consecutively by their lowest rank, the leader of a node is its lowest rank.
+class NodeTopology {
+public:
+  explicit NodeTopology(MPI_Comm comm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    // Ranks that can share memory form one node
+#if MPI_VERSION >= 3
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &nodeComm_);
+#else
+    char name[MPI_MAX_PROCESSOR_NAME];
+    int length;
+    MPI_Get_processor_name(name, &length);
+
+    const int color = std::hash<std::string>()(std::string(name, length)) & 0x7fffffff;
+    MPI_Comm_split(comm, color, rank, &nodeComm_);
+#endif
+
+    // Number the nodes by ranking their leaders
+    int nodeRank;
+    MPI_Comm_rank(nodeComm_, &nodeRank);
+
+    MPI_Comm leaderComm;
+    MPI_Comm_split(comm, (0 == nodeRank) ? 0 : MPI_UNDEFINED, rank, &leaderComm);
+
+    int node = 0;
+    if (leaderComm != MPI_COMM_NULL) {
+      MPI_Comm_rank(leaderComm, &node);
+      MPI_Comm_free(&leaderComm);
+    }
+
+    MPI_Bcast(&node, 1, MPI_INT, 0, nodeComm_);
+
+    // Share node numbers of all ranks
+    nodeOfRank_.resize(size);
+    MPI_Allgather(&node, 1, MPI_INT, nodeOfRank_.data(), 1, MPI_INT, comm);
+
+    ranksOfNode_.resize(*std::max_element(nodeOfRank_.begin(), nodeOfRank_.end()) + 1);
+    for (int p = 0; p < size; ++p)
+      ranksOfNode_[nodeOfRank_[p]].push_back(p);
+  }
+
+  ~NodeTopology() {
+    MPI_Comm_free(&nodeComm_);
+  }
+
+  int numNodes() const {
+    return ranksOfNode_.size();
+  }
+
+  // Node the given rank runs on
+  int node(int rank) const {
+    return nodeOfRank_[rank];
+  }
+
+  // Ranks on the given node in ascending order
+  const std::vector<int>& ranks(int node) const {
+    return ranksOfNode_[node];
+  }
+
+  bool isLeader(int rank) const {
+    return ranksOfNode_[nodeOfRank_[rank]].front() == rank;
+  }
+
+  // Communicator of all ranks on the calling rank's node
+  MPI_Comm nodeCommunicator() const {
+    return nodeComm_;
+  }
+
+private:
+  // Owns a communicator
+  NodeTopology(const NodeTopology&);
+  NodeTopology& operator=(const NodeTopology&);
+
+  MPI_Comm nodeComm_;
+  std::vector<int> nodeOfRank_;
+  std::vector<std::vector<int> > ranksOfNode_;
+};
+
+#endif
@@ -0,0 +1,774 @@
+#ifndef PARMETISGRIDPARTITIONER_H
+#define PARMETISGRIDPARTITIONER_H
+
+#include <dune/common/parallel/mpihelper.hh>
+#include <dune/common/exceptions.hh>
+#include <dune/geometry/referenceelements.hh>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include <mpi.h>
+
+#include <parmetis.h>
+
+#include <dune/ug_hpc/ElasticPartCount.hh>
+#include <dune/ug_hpc/GlobalUniqueIndex.hh>
+#include <dune/ug_hpc/GraphPartitioner.hh>
+#include <dune/ug_hpc/MemoryUsage.hh>
+#include <dune/ug_hpc/NodeTopology.hh>
+#include <dune/ug_hpc/PartitionConstraints.hh>
+#include <dune/ug_hpc/PartitionRemapping.hh>
+#include <dune/ug_hpc/SpaceFillingCurveOrdering.hh>
+
+
+template<class GridView>
+struct ParMetisGridPartitioner {
+#if PARMETIS_MAJOR_VERSION < 4
+  typedef idxtype idx_t;
+  typedef float real_t;
+#endif
+
+  typedef typename GridView::template Codim<0>::Iterator                                               ElementIterator;
+  typedef typename GridView::template Codim<0>::template Partition<Dune::Interior_Partition>::Iterator InteriorElementIterator;
+  typedef typename GridView::IntersectionIterator                                                      IntersectionIterator;
+  typedef typename GridView::template Codim<0>::Entity                                                 Element;
+
+  enum {
+    dimension = GridView::dimension
+  };
+
+
+  // The part count bounds the number of ranks that receive macro elements
+  static std::vector<unsigned> initialPartition(const GridView& gv, const Dune::MPIHelper& mpihelper,
+						const ElasticPartCount& partCount = ElasticPartCount()) {
+    const unsigned num_elems = gv.size(0);
+
+    std::vector<unsigned> part(num_elems);
+
+    // Setup parameters for (Par)METIS
+    idx_t ncon = 1;                                     // number of balance constraints
+    idx_t ncommonnodes = 2;                             // number of nodes elements must have in common in order to be adjacent to each other
+    idx_t nparts = partCount.parts(num_elems, mpihelper.size()); // number of parts, all processes unless elastic
+    std::vector<real_t> tpwgts(ncon*nparts, 1./nparts); // load per subdomain and weight (same load on every process)
+
+    // Create and fill arrays "eptr", where eptr[i] is the number of vertices that belong to the i-th element, and
+    // "eind" contains the vertex-numbers of the i-the element in eind[eptr[i]] to eind[eptr[i+1]-1]
+    std::vector<idx_t> eptr, eind;
+    int numVertices = 0;
+    eptr.push_back(numVertices);
+
+    for (InteriorElementIterator eIt = gv.template begin<0, Dune::Interior_Partition>(); eIt != gv.template end<0, Dune::Interior_Partition>(); ++eIt) {
+      const int curNumVertices = Dune::ReferenceElements<double, dimension>::general(eIt->type()).size(dimension);
+
+      numVertices += curNumVertices;
+      eptr.push_back(numVertices);
+
+      for (size_t k = 0; k < curNumVertices; ++k)
+	eind.push_back(gv.indexSet().subIndex(*eIt, k, dimension));
+    }
+
+    // Partition mesh on rank 0, which holds the whole macro grid
+    if (0 == mpihelper.rank()) {
+#if PARMETIS_MAJOR_VERSION >= 4
+      // Serial METIS computes the same partition without setting up ParMETIS on a one-rank communicator
+      idx_t ne = num_elems;
+      idx_t nn = gv.size(dimension);
+      idx_t objval;
+      std::vector<idx_t> npart(nn);
+
+      idx_t metisOptions[METIS_NOPTIONS];
+      METIS_SetDefaultOptions(metisOptions);
+      metisOptions[METIS_OPTION_NUMBERING] = 0;
+
+      // METIS does not split a mesh into a single part, and all elements already are on part 0
+      if (nparts > 1) {
+	const int OK =
+	  METIS_PartMeshDual(&ne, &nn, eptr.data(), eind.data(), NULL, NULL, &ncommonnodes, &nparts, tpwgts.data(),
+			     metisOptions, &objval, reinterpret_cast<idx_t*>(part.data()), npart.data());
+
+	if (OK != METIS_OK)
+	  DUNE_THROW(Dune::Exception, "METIS is not happy.");
+      }
+#else
+      idx_t wgtflag = 0;                                  // we don't use weights
+      idx_t numflag = 0;                                  // we are using C-style arrays
+      idx_t options[4] = {0, 0, 0, 0};                    // use default values for random seed, output and coupling
+      idx_t edgecut;                                      // will store number of edges cut by partition
+      std::vector<real_t> ubvec(ncon, 1.05);              // weight tolerance (same weight tolerance for every weight there is)
+
+      // The difference elmdist[i+1] - elmdist[i] is the number of elements on process i; the one-rank
+      // communicator holds all of them
+      std::vector<idx_t> elmdist(2, 0);
+      elmdist[1] = num_elems;
+
+      MPI_Comm comm = Dune::MPIHelper::getLocalCommunicator();
+
+      ParMETIS_V3_PartMeshKway(elmdist.data(), eptr.data(), eind.data(), NULL, &wgtflag, &numflag,
+			       &ncon, &ncommonnodes, &nparts, tpwgts.data(), ubvec.data(),
+			       options, &edgecut, reinterpret_cast<idx_t*>(part.data()), &comm);
+#endif
+    }
+
+    return part;
+  }
+
+  // The constraints determine the element weights, their tolerances and the target load of every part.
+  // If memoryStatistics is given, memory is sampled after the index map and the graph have been set up.
+  // If an up-to-date ordering is given, the graph vertices are laid out along it.
+  static std::vector<unsigned> repartition(const GridView& gv, const Dune::MPIHelper& mpihelper, real_t& itr = 1000,
+					   const PartitionConstraints<GridView>& constraints = PartitionConstraints<GridView>(),
+					   MemoryStatistics* memoryStatistics = NULL,
+					   const SpaceFillingCurveOrdering<GridView>* ordering = NULL) {
+
+    // Create global index map
+    GlobalUniqueIndex<GridView> globalIndex(gv, ordering);
+
+    if (memoryStatistics)
+      memoryStatistics->sample("globalIndex");
+
+    const unsigned num_elems = globalIndex.nOwnedLocalEntity();
+
+    std::vector<unsigned> interiorPart(num_elems);
+
+    // Setup parameters for ParMETIS
+    const bool weighted = constraints.weighted();
+    idx_t wgtflag = weighted ? 2 : 0;                          // weights on vertices only
+    idx_t numflag = 0;                                         // we are using C-style arrays
+    idx_t ncon = constraints.ncon();                           // number of balance constraints
+    idx_t options[4] = {0, 0, 0, 0};                           // use default values for random seed, output and coupling
+    idx_t edgecut;                                             // will store number of edges cut by partition
+    idx_t nparts = mpihelper.size();                           // number of parts equals number of processes
+    std::vector<real_t> tpwgts(constraints.tpwgts(nparts));    // load per subdomain and weight
+    std::vector<real_t> ubvec(constraints.ubvec());            // weight tolerance per weight
+
+    MPI_Comm comm = Dune::MPIHelper::getCommunicator();
+
+    // Setup graph for local elements
+    // The difference vtxdist[i+1] - vtxdist[i] is the number of elements that are on process i
+    std::vector<idx_t> vtxdist(globalIndex.indexOffset());
+
+    std::vector<idx_t> xadj, adjncy, vwgt;
+    buildGraph(gv, globalIndex, constraints, xadj, adjncy, vwgt, ordering);
+
+    if (memoryStatistics)
+      memoryStatistics->sample("graph");
+
+#if PARMETIS_MAJOR_VERSION >= 4
+    const int OK =
+#endif
+      ParMETIS_V3_AdaptiveRepart(vtxdist.data(), xadj.data(), adjncy.data(), weighted ? vwgt.data() : NULL, NULL, NULL,
+				 &wgtflag, &numflag, &ncon, &nparts, tpwgts.data(), ubvec.data(),
+				 &itr, options, &edgecut, reinterpret_cast<idx_t*>(interiorPart.data()), &comm);
+
+#if PARMETIS_MAJOR_VERSION >= 4
+    if (OK != METIS_OK)
+      DUNE_THROW(Dune::Exception, "ParMETIS is not happy.");
+#endif
+
+    return elementPart(gv, interiorPart, ordering);
+  }
+
+  // As repartition, but with any of the backends of GraphPartitioner; itr is used by the adaptive and zoltan methods.
+  // The part count is derived from the global number of elements; ranks without elements sit out of the backend.
+  static std::vector<unsigned> graphRepartition(const GridView& gv, const Dune::MPIHelper& mpihelper, GraphPartitioner::Method method,
+						real_t itr = 1000,
+						const PartitionConstraints<GridView>& constraints = PartitionConstraints<GridView>(),
+						MemoryStatistics* memoryStatistics = NULL,
+						const SpaceFillingCurveOrdering<GridView>* ordering = NULL,
+						const ElasticPartCount& partCount = ElasticPartCount()) {
+    GlobalUniqueIndex<GridView> globalIndex(gv, ordering);
+
+    if (memoryStatistics)
+      memoryStatistics->sample("globalIndex");
+
+    GraphPartitioner::Graph graph;
+    graph.vtxdist = globalIndex.indexOffset();
+    graph.ncon = constraints.ncon();
+    buildGraph(gv, globalIndex, constraints, graph.xadj, graph.adjncy, graph.vwgt, ordering);
+
+    if (memoryStatistics)
+      memoryStatistics->sample("graph");
+
+    const idx_t nparts = partCount.parts(graph.vtxdist.back(), mpihelper.size());
+    std::vector<real_t> tpwgts(constraints.tpwgts(nparts));
+    std::vector<real_t> ubvec(constraints.ubvec());
+
+    // All backends start from the current owner of every vertex
+    std::vector<idx_t> part(graph.numVertices(), mpihelper.rank());
+    GraphPartitioner::partition(method, graph, nparts, tpwgts, ubvec, itr, part, Dune::MPIHelper::getCommunicator());
+
+    return elementPart(gv, std::vector<unsigned>(part.begin(), part.end()), ordering);
+  }
+
+  // True if the dual graph of the interior leaf elements has at most maxVertices vertices in total (collective)
+  static bool smallGraph(const GridView& gv, long maxVertices) {
+    long vertices = 0;
+    for (InteriorElementIterator eIt = gv.template begin<0, Dune::Interior_Partition>(); eIt != gv.template end<0, Dune::Interior_Partition>(); ++eIt)
+      ++vertices;
+
+    return gv.comm().sum(vertices) <= maxVertices;
+  }
+
+  // Same as repartition, but the graph is gathered on rank 0 and split with serial METIS, which for small graphs
+  // is faster than the setup and the collectives of ParMETIS.  METIS partitions from scratch, so rank 0 relabels
+  // the parts to keep as much load as possible on its current rank before every rank receives its share.
+  // With an elastic part count, the parts go to the ranks that hold most of their load.
+  static std::vector<unsigned> serialRepartition(const GridView& gv, const Dune::MPIHelper& mpihelper,
+						 const PartitionConstraints<GridView>& constraints = PartitionConstraints<GridView>(),
+						 MemoryStatistics* memoryStatistics = NULL,
+						 const SpaceFillingCurveOrdering<GridView>* ordering = NULL,
+						 const ElasticPartCount& partCount = ElasticPartCount()) {
+#if PARMETIS_MAJOR_VERSION < 4
+    DUNE_THROW(Dune::NotImplemented, "Serial repartitioning needs METIS 5, i.e. ParMETIS 4 or newer.");
+#else
+    GlobalUniqueIndex<GridView> globalIndex(gv, ordering);
+
+    if (memoryStatistics)
+      memoryStatistics->sample("globalIndex");
+
+    const int rank = mpihelper.rank();
+    const int size = mpihelper.size();
+    const unsigned num_elems = globalIndex.nOwnedLocalEntity();
+
+    const std::vector<int>& vtxdist = globalIndex.indexOffset();
+
+    std::vector<idx_t> xadj, adjncy, vwgt;
+    buildGraph(gv, globalIndex, constraints, xadj, adjncy, vwgt, ordering);
+
+    if (memoryStatistics)
+      memoryStatistics->sample("graph");
+
+    const bool weighted = constraints.weighted();
+    idx_t ncon = constraints.ncon();
+    idx_t nparts = partCount.parts(vtxdist[size], size);
+
+    const MPI_Datatype idxType = (sizeof(idx_t) == 8) ? MPI_INT64_T : MPI_INT32_T;
+    MPI_Comm comm = Dune::MPIHelper::getCommunicator();
+
+    // Gather degrees, neighbors and weights on rank 0; the vertices of rank p are vtxdist[p], ..., vtxdist[p+1]-1
+    std::vector<idx_t> degrees(num_elems);
+    for (unsigned i = 0; i < num_elems; ++i)
+      degrees[i] = xadj[i+1] - xadj[i];
+
+    int numEdges = adjncy.size();
+    std::vector<int> vertexCounts(size), weightCounts(size), edgeCounts(size);
+    std::vector<int> vertexDispls(size), weightDispls(size), edgeDispls(size);
+
+    MPI_Gather(&numEdges, 1, MPI_INT, edgeCounts.data(), 1, MPI_INT, 0, comm);
+
+    int totalEdges = 0;
+    for (int p = 0; p < size; ++p) {
+      vertexCounts[p] = vtxdist[p+1] - vtxdist[p];
+      vertexDispls[p] = vtxdist[p];
+      weightCounts[p] = weighted ? ncon*vertexCounts[p] : 0;
+      weightDispls[p] = weighted ? ncon*vertexDispls[p] : 0;
+      edgeDispls[p] = totalEdges;
+      totalEdges += edgeCounts[p];
+    }
+
+    idx_t nvtxs = vtxdist[size];
+    const bool root = (0 == rank);
+
+    std::vector<idx_t> allDegrees(root ? nvtxs : 0), allAdjncy(root ? totalEdges : 0), allVwgt(root && weighted ? ncon*nvtxs : 0);
+
+    MPI_Gatherv(degrees.data(), num_elems, idxType, allDegrees.data(), vertexCounts.data(), vertexDispls.data(), idxType, 0, comm);
+    MPI_Gatherv(adjncy.data(), numEdges, idxType, allAdjncy.data(), edgeCounts.data(), edgeDispls.data(), idxType, 0, comm);
+    if (weighted)
+      MPI_Gatherv(vwgt.data(), vwgt.size(), idxType, allVwgt.data(), weightCounts.data(), weightDispls.data(), idxType, 0, comm);
+
+    std::vector<idx_t> allPart(root ? nvtxs : 0, 0);
+
+    if (root && nvtxs > 0) {
+      // METIS does not split a graph into a single part, all vertices are on part 0 then
+      if (nparts > 1) {
+	std::vector<idx_t> allXadj(nvtxs+1, 0);
+	for (idx_t v = 0; v < nvtxs; ++v)
+	  allXadj[v+1] = allXadj[v] + allDegrees[v];
+
+	std::vector<real_t> tpwgts(constraints.tpwgts(nparts));
+	std::vector<real_t> ubvec(constraints.ubvec());
+
+	idx_t options[METIS_NOPTIONS];
+	METIS_SetDefaultOptions(options);
+	options[METIS_OPTION_NUMBERING] = 0;
+
+	idx_t objval;
+
+	const int OK =
+	  METIS_PartGraphKway(&nvtxs, &ncon, allXadj.data(), allAdjncy.data(), weighted ? allVwgt.data() : NULL, NULL, NULL,
+			      &nparts, tpwgts.data(), ubvec.data(), options, &objval, allPart.data());
+
+	if (OK != METIS_OK)
+	  DUNE_THROW(Dune::Exception, "METIS is not happy.");
+      }
+
+      // Relabel the parts by the largest overlap with the current owners, parts with different target fractions
+      // keep the rank they were sized for
+      std::vector<double> overlap(size*nparts, 0);
+      for (int p = 0; p < size; ++p)
+	for (int v = vtxdist[p]; v < vtxdist[p+1]; ++v)
+	  overlap[p*nparts + allPart[v]] += weighted ? allVwgt[v*ncon] : 1;
+
+      std::vector<int> target(nparts);
+      PartitionRemapping<GridView>::assign(overlap, size, nparts, PartitionRemapping<GridView>::Greedy, constraints.targetGroups(nparts), target);
+
+      for (idx_t v = 0; v < nvtxs; ++v)
+	allPart[v] = target[allPart[v]];
+    }
+
+    // Every rank only receives the parts of its own vertices
+    std::vector<idx_t> localPart(num_elems);
+    MPI_Scatterv(allPart.data(), vertexCounts.data(), vertexDispls.data(), idxType, localPart.data(), num_elems, idxType, 0, comm);
+
+    return elementPart(gv, std::vector<unsigned>(localPart.begin(), localPart.end()), ordering);
+#endif
+  }
+
+  // Partitions the macro elements instead of the leaf elements.  loadBalance(part, 0) moves whole macro element
+  // families, so this graph has one vertex per level-0 element, weighted with the sum of the constraint weights of
+  // its leaf descendants (their number if the constraints are unweighted), and its edges are weighted with the
+  // number of leaf faces shared by two families.  All leaves of a family get the part of their macro element.
+  static std::vector<unsigned> coarseRepartition(const GridView& gv, const Dune::MPIHelper& mpihelper, real_t& itr = 1000,
+						 const PartitionConstraints<GridView>& constraints = PartitionConstraints<GridView>(),
+						 MemoryStatistics* memoryStatistics = NULL) {
+    typedef typename GridView::Grid::LevelGridView LevelGridView;
+
+    const LevelGridView coarse = gv.grid().levelGridView(0);
+
+    GlobalUniqueIndex<LevelGridView> macroIndex(coarse);
+
+    if (memoryStatistics)
+      memoryStatistics->sample("globalIndex");
+
+    const int rank = mpihelper.rank();
+    const idx_t ncon = constraints.ncon();
+    const unsigned num_macros = macroIndex.nOwnedLocalEntity();
+
+    std::vector<idx_t> vtxdist(macroIndex.indexOffset());
+    const idx_t firstMacro = vtxdist[rank];
+
+    // Accumulate leaf weights and shared leaf faces per owned macro element.  Since families are never split,
+    // the macro ancestor of an interior leaf is interior as well; anything else is skipped.
+    std::vector<idx_t> vwgt(ncon*num_macros, 0), leafWeights(ncon, 1), leafCount(num_macros, 0);
+    std::vector<std::map<idx_t, idx_t> > edges(num_macros);
+    std::vector<idx_t> leafMacro; // local macro number of every interior leaf, in traversal order
+
+    for (InteriorElementIterator eIt = gv.template begin<0, Dune::Interior_Partition>(); eIt != gv.template end<0, Dune::Interior_Partition>(); ++eIt) {
+      const idx_t macro = macroIndex.findGlobalIndex(*macroAncestor(*eIt)) - firstMacro;
+      leafMacro.push_back(macro);
+
+      if (macro < 0 || macro >= static_cast<idx_t>(num_macros))
+	continue;
+
+      if (constraints.weighted())
+	constraints.weights(gv, *eIt, leafWeights.data());
+
+      for (idx_t j = 0; j < ncon; ++j)
+	vwgt[macro*ncon + j] += leafWeights[j];
+      ++leafCount[macro];
+
+      for (IntersectionIterator iIt = gv.ibegin(*eIt); iIt != gv.iend(*eIt); ++iIt) {
+	if (iIt->neighbor()) {
+	  const idx_t neighbor = macroIndex.findGlobalIndex(*macroAncestor(*iIt->outside()));
+
+	  if (neighbor >= 0 && neighbor != macro + firstMacro)
+	    ++edges[macro][neighbor];
+	}
+      }
+    }
+
+    // Setup the CSR graph of the owned macro elements, ordered by their global index
+    std::vector<idx_t> xadj(1, 0), adjncy, adjwgt;
+    for (unsigned i = 0; i < num_macros; ++i) {
+      for (typename std::map<idx_t, idx_t>::const_iterator it = edges[i].begin(); it != edges[i].end(); ++it) {
+	adjncy.push_back(it->first);
+	adjwgt.push_back(it->second);
+      }
+
+      xadj.push_back(adjncy.size());
+    }
+
+    if (constraints.weighted())
+      replaceVanishingConstraints(gv, ncon, vwgt, leafCount);
+
+    if (memoryStatistics)
+      memoryStatistics->sample("graph");
+
+    std::vector<idx_t> macroPart(num_macros);
+
+    idx_t wgtflag = 3;                                      // weights on vertices and edges
+    idx_t numflag = 0;                                      // we are using C-style arrays
+    idx_t nconParMetis = ncon;
+    idx_t options[4] = {0, 0, 0, 0};                        // use default values for random seed, output and coupling
+    idx_t edgecut;                                          // will store number of edges cut by partition
+    idx_t nparts = mpihelper.size();                        // number of parts equals number of processes
+    std::vector<real_t> tpwgts(constraints.tpwgts(nparts)); // load per subdomain and weight
+    std::vector<real_t> ubvec(constraints.ubvec());         // weight tolerance per weight
+
+    MPI_Comm comm = Dune::MPIHelper::getCommunicator();
+
+#if PARMETIS_MAJOR_VERSION >= 4
+    const int OK =
+#endif
+      ParMETIS_V3_AdaptiveRepart(vtxdist.data(), xadj.data(), adjncy.data(), vwgt.data(), NULL, adjwgt.data(),
+				 &wgtflag, &numflag, &nconParMetis, &nparts, tpwgts.data(), ubvec.data(),
+				 &itr, options, &edgecut, macroPart.data(), &comm);
+
+#if PARMETIS_MAJOR_VERSION >= 4
+    if (OK != METIS_OK)
+      DUNE_THROW(Dune::Exception, "ParMETIS is not happy.");
+#endif
+
+    // Every leaf inherits the part of its macro element
+    std::vector<unsigned> interiorPart(leafMacro.size(), rank);
+    for (size_t i = 0; i < leafMacro.size(); ++i)
+      if (leafMacro[i] >= 0 && leafMacro[i] < static_cast<idx_t>(num_macros))
+	interiorPart[i] = macroPart[leafMacro[i]];
+
+    return elementPart(gv, interiorPart);
+  }
+
+  // Two-level partitioning for clusters of shared-memory nodes: the graph is first split into one part per
+  // node, so that cut edges between these parts are the inter-node links.  The subgraph of every node is then
+  // gathered on the node's leader and split among the ranks of that node with serial METIS.  Both levels
+  // partition from scratch, so their parts are relabeled by the largest overlap with the current nodes and ranks,
+  // among parts of the same target load, to keep the migration low.  itr is only used by the flat repartition
+  // that replaces the hierarchy on a single node or with a single rank per node.
+  static std::vector<unsigned> hierarchicalRepartition(const GridView& gv, const Dune::MPIHelper& mpihelper,
+						       const NodeTopology& topology, real_t itr = 1000,
+						       const PartitionConstraints<GridView>& constraints = PartitionConstraints<GridView>(),
+						       MemoryStatistics* memoryStatistics = NULL) {
+    const int numNodes = topology.numNodes();
+
+    // Nothing to gain from a hierarchy with a single node or a single rank per node
+    if (numNodes == 1 || numNodes == mpihelper.size())
+      return repartition(gv, mpihelper, itr, constraints, memoryStatistics);
+
+#if PARMETIS_MAJOR_VERSION < 4
+    DUNE_THROW(Dune::NotImplemented, "Hierarchical partitioning needs ParMETIS 4 or newer.");
+#else
+    GlobalUniqueIndex<GridView> globalIndex(gv);
+
+    if (memoryStatistics)
+      memoryStatistics->sample("globalIndex");
+
+    const unsigned num_elems = globalIndex.nOwnedLocalEntity();
+
+    std::vector<idx_t> nodePart(num_elems);
+
+    std::vector<idx_t> vtxdist(globalIndex.indexOffset());
+    std::vector<idx_t> xadj, adjncy, vwgt;
+    buildGraph(gv, globalIndex, constraints, xadj, adjncy, vwgt);
+
+    if (memoryStatistics)
+      memoryStatistics->sample("graph");
+
+    const bool weighted = constraints.weighted();
+    idx_t ncon = constraints.ncon();
+
+    // The target load of a node is the sum of the target loads of its ranks
+    const std::vector<real_t> rankTpwgts(constraints.tpwgts(mpihelper.size()));
+    std::vector<real_t> nodeTpwgts(ncon*numNodes, 0);
+    for (int p = 0; p < mpihelper.size(); ++p)
+      for (idx_t j = 0; j < ncon; ++j)
+	nodeTpwgts[topology.node(p)*ncon + j] += rankTpwgts[p*ncon + j];
+
+    std::vector<real_t> ubvec(constraints.ubvec());
+
+    // 1st level: partition across nodes.  AdaptiveRepart assumes one part per rank, so the graph is
+    // partitioned from scratch here.
+    {
+      idx_t wgtflag = weighted ? 2 : 0;
+      idx_t numflag = 0;
+      idx_t options[3] = {0, 0, 0};
+      idx_t edgecut;
+      idx_t nparts = numNodes;
+
+      MPI_Comm comm = Dune::MPIHelper::getCommunicator();
+
+      const int OK =
+	ParMETIS_V3_PartKway(vtxdist.data(), xadj.data(), adjncy.data(), weighted ? vwgt.data() : NULL, NULL,
+			     &wgtflag, &numflag, &ncon, &nparts, nodeTpwgts.data(), ubvec.data(),
+			     options, &edgecut, nodePart.data(), &comm);
+
+      if (OK != METIS_OK)
+	DUNE_THROW(Dune::Exception, "ParMETIS is not happy.");
+
+      // Relabel the node parts by their overlap with the current nodes, overlap[n*numNodes + l] being the load
+      // on node n labeled l
+      const int node = topology.node(mpihelper.rank());
+      std::vector<double> localOverlap(numNodes*numNodes, 0), overlap(numNodes*numNodes);
+      for (unsigned i = 0; i < num_elems; ++i)
+	localOverlap[node*numNodes + nodePart[i]] += weighted ? vwgt[i*ncon] : 1;
+
+      MPI_Allreduce(localOverlap.data(), overlap.data(), overlap.size(), MPI_DOUBLE, MPI_SUM, comm);
+
+      std::vector<int> target(numNodes);
+      LabelAssignment::assign(overlap, numNodes, numNodes, LabelAssignment::Greedy, targetGroups(nodeTpwgts, ncon, numNodes), target);
+
+      for (unsigned i = 0; i < num_elems; ++i)
+	nodePart[i] = target[nodePart[i]];
+    }
+
+    // 2nd level: send every element to the leader of its node, as the tuple
+    // (global index, ncon weights, degree, neighbors)
+    const int size = mpihelper.size();
+    const MPI_Datatype idxType = (sizeof(idx_t) == 8) ? MPI_INT64_T : MPI_INT32_T;
+    MPI_Comm comm = Dune::MPIHelper::getCommunicator();
+
+    std::vector<std::vector<idx_t> > sendData(size);
+    std::vector<std::vector<unsigned> > sentElements(size); // local element numbers in the order they were sent
+
+    for (unsigned i = 0; i < num_elems; ++i) {
+      const int leader = topology.ranks(nodePart[i]).front();
+      std::vector<idx_t>& buffer = sendData[leader];
+
+      buffer.push_back(vtxdist[mpihelper.rank()] + i);
+      for (idx_t j = 0; j < ncon; ++j)
+	buffer.push_back(weighted ? vwgt[i*ncon + j] : 1);
+      buffer.push_back(xadj[i+1] - xadj[i]);
+      buffer.insert(buffer.end(), adjncy.begin() + xadj[i], adjncy.begin() + xadj[i+1]);
+
+      sentElements[leader].push_back(i);
+    }
+
+    std::vector<idx_t> received;
+    std::vector<int> recvCounts, recvDispls;
+    exchange(sendData, received, recvCounts, recvDispls, idxType, comm);
+
+    // On node leaders: assemble the node subgraph, dropping all edges that leave the node, and split it with METIS
+    std::vector<std::vector<idx_t> > reply(size);
+
+    if (topology.isLeader(mpihelper.rank())) {
+      const std::vector<int>& nodeRanks = topology.ranks(topology.node(mpihelper.rank()));
+
+      std::map<idx_t, idx_t> local; // global index -> vertex number in the node subgraph
+      std::vector<int> source;      // rank that sent each vertex
+      for (int p = 0; p < size; ++p)
+	for (int k = recvDispls[p]; k < recvDispls[p] + recvCounts[p]; k += 2 + ncon + received[k + 1 + ncon]) {
+	  local.insert(std::make_pair(received[k], static_cast<idx_t>(local.size())));
+	  source.push_back(p);
+	}
+
+      idx_t nvtxs = local.size();
+      std::vector<idx_t> subXadj(1, 0), subAdjncy, subVwgt;
+      for (int p = 0; p < size; ++p)
+	for (int k = recvDispls[p]; k < recvDispls[p] + recvCounts[p]; k += 2 + ncon + received[k + 1 + ncon]) {
+	  subVwgt.insert(subVwgt.end(), received.begin() + k + 1, received.begin() + k + 1 + ncon);
+
+	  const idx_t degree = received[k + 1 + ncon];
+	  for (idx_t l = 0; l < degree; ++l) {
+	    typename std::map<idx_t, idx_t>::const_iterator it = local.find(received[k + 2 + ncon + l]);
+	    if (it != local.end())
+	      subAdjncy.push_back(it->second);
+	  }
+
+	  subXadj.push_back(subAdjncy.size());
+	}
+
+      // Target load of each rank relative to its node
+      idx_t nparts = nodeRanks.size();
+      std::vector<real_t> subTpwgts(ncon*nparts);
+      for (idx_t q = 0; q < nparts; ++q)
+	for (idx_t j = 0; j < ncon; ++j)
+	  subTpwgts[q*ncon + j] = rankTpwgts[nodeRanks[q]*ncon + j] / nodeTpwgts[topology.node(mpihelper.rank())*ncon + j];
+
+      std::vector<idx_t> subPart(nvtxs, 0);
+      if (nvtxs > 0 && nparts > 1) {
+	idx_t options[METIS_NOPTIONS];
+	METIS_SetDefaultOptions(options);
+	options[METIS_OPTION_NUMBERING] = 0;
+
+	idx_t objval;
+
+	const int OK =
+	  METIS_PartGraphKway(&nvtxs, &ncon, subXadj.data(), subAdjncy.data(), subVwgt.data(), NULL, NULL,
+			      &nparts, subTpwgts.data(), ubvec.data(), options, &objval, subPart.data());
+
+	if (OK != METIS_OK)
+	  DUNE_THROW(Dune::Exception, "METIS is not happy.");
+      }
+
+      // Relabel the rank parts by their overlap with the ranks of the node that sent the elements; elements
+      // from other nodes have no place to stay
+      std::vector<double> overlap(nparts*nparts, 0);
+      for (idx_t v = 0; v < nvtxs; ++v) {
+	const idx_t q = std::find(nodeRanks.begin(), nodeRanks.end(), source[v]) - nodeRanks.begin();
+	if (q < nparts)
+	  overlap[q*nparts + subPart[v]] += subVwgt[v*ncon];
+      }
+
+      std::vector<int> target(nparts);
+      LabelAssignment::assign(overlap, nparts, nparts, LabelAssignment::Greedy, targetGroups(subTpwgts, ncon, nparts), target);
+
+      // Answer every sender with the target ranks of its elements, in the order they were received
+      for (idx_t v = 0; v < nvtxs; ++v)
+	reply[source[v]].push_back(nodeRanks[target[subPart[v]]]);
+    }
+
+    std::vector<idx_t> targets;
+    exchange(reply, targets, recvCounts, recvDispls, idxType, comm);
+
+    std::vector<unsigned> interiorPart(num_elems);
+    for (int p = 0; p < size; ++p)
+      for (size_t k = 0; k < sentElements[p].size(); ++k)
+	interiorPart[sentElements[p][k]] = targets[recvDispls[p] + k];
+
+    return elementPart(gv, interiorPart);
+#endif
+  }
+
+  // Assembles the dual graph of the interior elements in distributed CSR format, with the vertices numbered by
+  // globalIndex, and the vertex weights given by the constraints (empty if the constraints are unweighted).
+  // The rows are in traversal order, or in the order of the ordering if one is given; globalIndex has to number
+  // the elements the same way.
+  static void buildGraph(const GridView& gv, const GlobalUniqueIndex<GridView>& globalIndex, const PartitionConstraints<GridView>& constraints,
+			 std::vector<idx_t>& xadj, std::vector<idx_t>& adjncy, std::vector<idx_t>& vwgt,
+			 const SpaceFillingCurveOrdering<GridView>* ordering = NULL) {
+    const bool weighted = constraints.weighted();
+
+    xadj.assign(1, 0);
+    adjncy.clear();
+    vwgt.clear();
+
+    if (ordering) {
+      for (size_t i = 0; i < ordering->elements().size(); ++i)
+	appendVertex(gv, globalIndex, constraints, *gv.grid().entityPointer(ordering->elements()[i]), xadj, adjncy, vwgt);
+    }
+    else {
+      for (InteriorElementIterator eIt = gv.template begin<0, Dune::Interior_Partition>(); eIt != gv.template end<0, Dune::Interior_Partition>(); ++eIt)
+	appendVertex(gv, globalIndex, constraints, *eIt, xadj, adjncy, vwgt);
+    }
+
+    if (weighted)
+      replaceVanishingConstraints(gv, constraints.ncon(), vwgt);
+  }
+
+  // At this point, interiorPart contains a target rank for each interior element, and they are sorted
+  // by the order in which the grid view traverses them.  Now we need to do two things:
+  // a) Add additional dummy entries for the ghost elements
+  // b) Use the element index for the actual ordering.  Since there may be different types of elements,
+  //    we cannot use the index set directly, but have to go through a Mapper.
+  //    If an ordering is given, interiorPart follows the ordering instead of the traversal.
+  static std::vector<unsigned> elementPart(const GridView& gv, const std::vector<unsigned>& interiorPart,
+					   const SpaceFillingCurveOrdering<GridView>* ordering = NULL) {
+    typedef Dune::MultipleCodimMultipleGeomTypeMapper<GridView, Dune::MCMGElementLayout> ElementMapper;
+    ElementMapper elementMapper(gv);
+
+    std::vector<unsigned int> part(gv.size(0));
+    std::fill(part.begin(), part.end(), 0);
+
+    if (ordering) {
+      for (size_t i = 0; i < ordering->elements().size(); ++i)
+	part[elementMapper.map(*gv.grid().entityPointer(ordering->elements()[i]))] = interiorPart[i];
+
+      return part;
+    }
+
+    unsigned int c = 0;
+    for (InteriorElementIterator eIt = gv.template begin<0, Dune::Interior_Partition>();
+         eIt != gv.template end<0, Dune::Interior_Partition>();
+         ++eIt)
+    {
+      part[elementMapper.map(*eIt)] = interiorPart[c++];
+    }
+    return part;
+  }
+
+private:
+  // ParMETIS normalizes every constraint by its global sum, so a constraint that vanishes everywhere (e.g. no
+  // boundary faces at all) is replaced by the plain element count, elements[i] for vertex i or one if empty
+  static void replaceVanishingConstraints(const GridView& gv, idx_t ncon, std::vector<idx_t>& vwgt,
+					  const std::vector<idx_t>& elements = std::vector<idx_t>()) {
+    std::vector<idx_t> sums(ncon, 0);
+    for (size_t i = 0; i < vwgt.size(); ++i)
+      sums[i % ncon] += vwgt[i];
+
+    gv.comm().template sum<idx_t>(sums.data(), ncon);
+
+    for (size_t i = 0; i < vwgt.size(); ++i)
+      if (0 == sums[i % ncon])
+	vwgt[i] = elements.empty() ? 1 : elements[i / ncon];
+  }
+
+  // Groups of parts with the same ncon target weights in tpwgts, group[i] being the first part with the targets
+  // of part i, for LabelAssignment
+  static std::vector<int> targetGroups(const std::vector<real_t>& tpwgts, idx_t ncon, idx_t nparts) {
+    std::vector<int> group(nparts);
+    for (idx_t i = 0; i < nparts; ++i)
+      for (idx_t k = 0; k <= i; ++k)
+	if (std::equal(tpwgts.begin() + i*ncon, tpwgts.begin() + (i+1)*ncon, tpwgts.begin() + k*ncon)) {
+	  group[i] = k;
+	  break;
+	}
+
+    return group;
+  }
+
+  typedef typename GridView::template Codim<0>::EntityPointer ElementPointer;
+
+  // Appends one row for element to the CSR graph
+  static void appendVertex(const GridView& gv, const GlobalUniqueIndex<GridView>& globalIndex, const PartitionConstraints<GridView>& constraints,
+			   const Element& element, std::vector<idx_t>& xadj, std::vector<idx_t>& adjncy, std::vector<idx_t>& vwgt) {
+    size_t numNeighbors = 0;
+
+    if (constraints.weighted()) {
+      const idx_t ncon = constraints.ncon();
+
+      vwgt.resize(vwgt.size() + ncon);
+      constraints.weights(gv, element, &vwgt[vwgt.size() - ncon]);
+    }
+
+    for (IntersectionIterator iIt = gv.ibegin(element); iIt != gv.iend(element); ++iIt) {
+      if (iIt->neighbor()) {
+	adjncy.push_back(globalIndex.globalIndex(*iIt->outside()));
+
+	++numNeighbors;
+      }
+    }
+
+    xadj.push_back(xadj.back() + numNeighbors);
+  }
+
+  // The level-0 ancestor of an element
+  static ElementPointer macroAncestor(const Element& element) {
+    ElementPointer ancestor(element);
+    while (ancestor->level() > 0)
+      ancestor = ancestor->father();
+
+    return ancestor;
+  }
+
+  // Personalized all-to-all exchange of variable length messages; on return, the message from rank p is stored in
+  // recv[recvDispls[p]] to recv[recvDispls[p] + recvCounts[p] - 1]
+  template<class T>
+  static void exchange(const std::vector<std::vector<T> >& send, std::vector<T>& recv,
+		       std::vector<int>& recvCounts, std::vector<int>& recvDispls, MPI_Datatype type, MPI_Comm comm) {
+    const int size = send.size();
+
+    std::vector<int> sendCounts(size), sendDispls(size+1, 0);
+    for (int p = 0; p < size; ++p) {
+      sendCounts[p] = send[p].size();
+      sendDispls[p+1] = sendDispls[p] + sendCounts[p];
+    }
+
+    std::vector<T> sendBuffer(sendDispls[size]);
+    for (int p = 0; p < size; ++p)
+      std::copy(send[p].begin(), send[p].end(), sendBuffer.begin() + sendDispls[p]);
+
+    recvCounts.resize(size);
+    MPI_Alltoall(sendCounts.data(), 1, MPI_INT, recvCounts.data(), 1, MPI_INT, comm);
+
+    recvDispls.assign(size+1, 0);
+    for (int p = 0; p < size; ++p)
+      recvDispls[p+1] = recvDispls[p] + recvCounts[p];
+
+    recv.resize(recvDispls[size]);
+    MPI_Alltoallv(sendBuffer.data(), sendCounts.data(), sendDispls.data(), type,
+		  recv.data(), recvCounts.data(), recvDispls.data(), type, comm);
+  }
+};
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef PARTITIONCACHE_H
+#define PARTITIONCACHE_H
+
+#include <dune/common/fvector.hh>
+#include <dune/grid/common/mcmgmapper.hh>
+
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+
+
+// Partitions of recent grid states, for grids that return to an earlier state, e.g. a periodic ball motion or
+// coarsening to the macro grid followed by the same refinement.  A state is identified by a fingerprint of
+// the interior leaf elements, their levels and their ranks: every element is hashed from its level and its
+// center, rounded to the given resolution, and the hashes are summed over the elements and ranks, so the
+// fingerprint costs one sweep and one reduction.  UG gives recreated elements new ids, the centers of
+// identically refined elements are the same.  A partition is only reused if the fingerprint matches and
+// every rank finds all its elements in the stored entry.
+template<class GridView>
+class PartitionCache {
+public:
+  typedef typename GridView::template Codim<0>::template Partition<Dune::Interior_Partition>::Iterator InteriorElementIterator;
+  typedef typename GridView::template Codim<0>::Entity                                                 Element;
+
+  typedef Dune::MultipleCodimMultipleGeomTypeMapper<GridView, Dune::MCMGElementLayout> ElementMapper;
+
+  enum {
+    dimension = GridView::dimension
+  };
+
+  // Number of interior elements and two independent sums of their hashes, over all ranks
+  struct Fingerprint {
+    uint64_t elements, sum, mixed;
+
+    bool operator==(const Fingerprint& other) const {
+      return elements == other.elements && sum == other.sum && mixed == other.mixed;
+    }
+  };
+
+  // capacity: number of partitions kept, the least recently used one is dropped first.
+  // resolution: element centers closer than this are considered equal.
+  explicit PartitionCache(size_t capacity = 8, double resolution = 1e-9) :
+    capacity_(capacity), resolution_(resolution), hits_(0), misses_(0)
+  {}
+
+  // Collective: fingerprint of the current leaf grid and its distribution
+  Fingerprint fingerprint(const GridView& gv) const {
+    const uint64_t rank = gv.comm().rank();
+
+    uint64_t values[3] = {0, 0, 0};
+    for (InteriorElementIterator eIt = gv.template begin<0, Dune::Interior_Partition>(); eIt != gv.template end<0, Dune::Interior_Partition>(); ++eIt) {
+      const uint64_t h = mix(key(*eIt) + rank * 0x9e3779b97f4a7c15ull);
+
+      ++values[0];
+      values[1] += h;
+      values[2] += mix(h ^ 0xd1b54a32d192ed03ull);
+    }
+
+    gv.comm().sum(values, 3);
+
+    Fingerprint f = {values[0], values[1], values[2]};
+    return f;
+  }
+
+  // Collective: if a partition of the state f is stored, writes it to part, indexed by the element mapper of
+  // gv with zeros for the ghosts like ParMetisGridPartitioner::elementPart, and returns true
+  bool lookup(const GridView& gv, const Fingerprint& f, std::vector<unsigned>& part) {
+    typename std::list<Entry>::iterator entry = entries_.begin();
+    while (entry != entries_.end() && !(entry->fingerprint == f))
+      ++entry;
+
+    // The fingerprint is the same on all ranks, so they all take the same branch
+    if (entry == entries_.end()) {
+      ++misses_;
+      return false;
+    }
+
+    ElementMapper elementMapper(gv);
+    std::vector<unsigned> result(gv.size(0), 0);
+
+    int found = 1;
+    for (InteriorElementIterator eIt = gv.template begin<0, Dune::Interior_Partition>(); eIt != gv.template end<0, Dune::Interior_Partition>(); ++eIt) {
+      const std::pair<uint64_t, unsigned> k(key(*eIt), 0);
+      const typename std::vector<std::pair<uint64_t, unsigned> >::const_iterator it = std::lower_bound(entry->parts.begin(), entry->parts.end(), k);
+
+      if (it == entry->parts.end() || it->first != k.first) {
+	found = 0;
+	break;
+      }
+
+      result[elementMapper.map(*eIt)] = it->second;
+    }
+
+    if (!gv.comm().min(found)) {
+      entries_.erase(entry);
+      ++misses_;
+      return false;
+    }
+
+    // Most recently used first
+    entries_.splice(entries_.begin(), entries_, entry);
+    part.swap(result);
+    ++hits_;
+
+    return true;
+  }
+
+  // Stores part, indexed by the element mapper of gv, as the partition of the state f
+  void store(const GridView& gv, const Fingerprint& f, const std::vector<unsigned>& part) {
+    if (0 == capacity_)
+      return;
+
+    ElementMapper elementMapper(gv);
+
+    entries_.push_front(Entry());
+    Entry& entry = entries_.front();
+    entry.fingerprint = f;
+
+    for (InteriorElementIterator eIt = gv.template begin<0, Dune::Interior_Partition>(); eIt != gv.template end<0, Dune::Interior_Partition>(); ++eIt)
+      entry.parts.push_back(std::make_pair(key(*eIt), part[elementMapper.map(*eIt)]));
+
+    std::sort(entry.parts.begin(), entry.parts.end());
+
+    if (entries_.size() > capacity_)
+      entries_.pop_back();
+  }
+
+  size_t hits() const {
+    return hits_;
+  }
+
+  size_t misses() const {
+    return misses_;
+  }
+
+private:
+  struct Entry {
+    Fingerprint fingerprint;
+    std::vector<std::pair<uint64_t, unsigned> > parts; // element key and part, sorted by key
+  };
+
+  // Hash of the level and the rounded center of element
+  uint64_t key(const Element& element) const {
+    const Dune::FieldVector<double, dimension> center = element.geometry().center();
+
+    uint64_t h = mix(element.level() + 1);
+    for (int j = 0; j < dimension; ++j)
+      h = mix(h ^ static_cast<uint64_t>(static_cast<int64_t>(std::floor(center[j] / resolution_ + 0.5))));
+
+    return h;
+  }
+
+  // splitmix64 finalizer
+  static uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+
+    return x;
+  }
+
+  size_t capacity_;
+  double resolution_;
+  size_t hits_, misses_;
+
+  std::list<Entry> entries_;
+};
+
+#endif
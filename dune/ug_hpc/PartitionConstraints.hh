@@ -0,0 +1,180 @@
+#ifndef PARTITIONCONSTRAINTS_H
+#define PARTITIONCONSTRAINTS_H
+
+#include <dune/common/exceptions.hh>
+
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include <parmetis.h>
+
+#include <dune/ug_hpc/RefinementPredictor.hh>
+
+
+// Describes the balance constraints handed to ParMETIS: which weights every element carries, the tolerance
+// of each weight and the fraction of the total load every part should receive.  Without any constraint the
+// graph is unweighted and all parts get the same number of elements.
+template<class GridView>
+class PartitionConstraints {
+public:
+#if PARMETIS_MAJOR_VERSION < 4
+  typedef idxtype idx_t;
+  typedef float real_t;
+#endif
+
+  typedef typename GridView::template Codim<0>::Entity Element;
+  typedef typename GridView::IntersectionIterator      IntersectionIterator;
+
+  enum {
+    dimension = GridView::dimension
+  };
+
+  enum Kind {
+    Elements,      // one per element, i.e. the compute work of the element loops
+    BoundaryFaces, // number of faces on the domain boundary, i.e. the work of boundary terms
+    Level,         // refinement level plus one, i.e. the work of level dependent operations
+    Memory,        // estimated memory footprint of the element and its share of its ancestors
+    Predicted      // load of the element after the next adaptation step, needs a RefinementPredictor
+  };
+
+  PartitionConstraints() : predictor_(NULL) {}
+
+  static Kind kind(const std::string& name) {
+    if (name == "elements")
+      return Elements;
+    if (name == "boundary")
+      return BoundaryFaces;
+    if (name == "level")
+      return Level;
+    if (name == "memory")
+      return Memory;
+    if (name == "predicted")
+      return Predicted;
+
+    DUNE_THROW(Dune::Exception, "Unknown partition constraint " << name << ".");
+  }
+
+  // Adds a balance constraint; tolerance is the allowed ratio of the heaviest part to its target weight
+  void add(Kind kind, real_t tolerance = 1.05) {
+    kinds_.push_back(kind);
+    tolerances_.push_back(tolerance);
+  }
+
+  // Predictor for the Predicted constraint; it is not copied and has to outlive the constraints
+  void setPredictor(const RefinementPredictor<dimension>* predictor) {
+    predictor_ = predictor;
+  }
+
+  // Target fraction of the total load for every part, e.g. to give faster ranks more elements.  The fractions
+  // are normalized and apply to all constraints.  An empty vector means the same load on every part.
+  void setTargetFractions(const std::vector<real_t>& fractions) {
+    targetFractions_ = fractions;
+  }
+
+  // True if elements carry weights, false if ParMETIS should balance the plain element count
+  bool weighted() const {
+    return !kinds_.empty();
+  }
+
+  idx_t ncon() const {
+    return weighted() ? kinds_.size() : 1;
+  }
+
+  // Writes the ncon() weights of element to w
+  void weights(const GridView& gv, const Element& element, idx_t* w) const {
+    for (size_t j = 0; j < kinds_.size(); ++j) {
+      switch (kinds_[j]) {
+      case Elements:
+	w[j] = 1;
+	break;
+
+      case BoundaryFaces:
+	w[j] = 0;
+	for (IntersectionIterator iIt = gv.ibegin(element); iIt != gv.iend(element); ++iIt)
+	  if (iIt->boundary())
+	    ++w[j];
+	break;
+
+      case Level:
+	w[j] = element.level() + 1;
+	break;
+
+      case Memory:
+	w[j] = memoryWeight(element);
+	break;
+
+      case Predicted:
+	if (!predictor_)
+	  DUNE_THROW(Dune::Exception, "Predicted partition constraint without a predictor.");
+	w[j] = predictor_->predictedLoad(element);
+	break;
+      }
+    }
+  }
+
+  // Target weights, tpwgts[i*ncon+j] is the fraction of constraint j that part i should receive
+  std::vector<real_t> tpwgts(idx_t nparts) const {
+    const idx_t n = ncon();
+
+    std::vector<real_t> fractions(nparts, 1./nparts);
+    if (!targetFractions_.empty()) {
+      if (targetFractions_.size() != static_cast<size_t>(nparts))
+	DUNE_THROW(Dune::Exception, "Expected " << nparts << " target fractions, got " << targetFractions_.size() << ".");
+
+      const real_t sum = std::accumulate(targetFractions_.begin(), targetFractions_.end(), real_t(0));
+      for (idx_t i = 0; i < nparts; ++i)
+	fractions[i] = targetFractions_[i] / sum;
+    }
+
+    std::vector<real_t> result(n*nparts);
+    for (idx_t i = 0; i < nparts; ++i)
+      std::fill(result.begin() + i*n, result.begin() + (i+1)*n, fractions[i]);
+
+    return result;
+  }
+
+  // Groups of parts with the same target fraction, group[i] being the first part with the fraction of part i.
+  // Relabeling may only exchange parts within a group.  Empty if all parts have the same target.
+  std::vector<int> targetGroups(idx_t nparts) const {
+    std::vector<int> group;
+    if (targetFractions_.empty())
+      return group;
+
+    if (targetFractions_.size() != static_cast<size_t>(nparts))
+      DUNE_THROW(Dune::Exception, "Expected " << nparts << " target fractions, got " << targetFractions_.size() << ".");
+
+    group.resize(nparts);
+    for (idx_t i = 0; i < nparts; ++i)
+      group[i] = std::find(targetFractions_.begin(), targetFractions_.end(), targetFractions_[i]) - targetFractions_.begin();
+
+    return group;
+  }
+
+  // Weight tolerance per constraint
+  std::vector<real_t> ubvec() const {
+    return weighted() ? tolerances_ : std::vector<real_t>(1, 1.05);
+  }
+
+  // Estimated memory footprint of a leaf element relative to a macro element.  Since loadBalance moves whole
+  // element families, a rank also stores the ancestors of its leaves; each ancestor is shared by all of its
+  // 2^dim children, so a leaf on level l accounts for sum_{k=0}^{l} 2^{-dim*k} element records.
+  static idx_t memoryWeight(const Element& element) {
+    const double children = 1 << dimension;
+
+    double weight = 0, share = 1;
+    for (int k = 0; k <= element.level(); ++k, share /= children)
+      weight += share;
+
+    return static_cast<idx_t>(100*weight + 0.5);
+  }
+
+private:
+  std::vector<Kind> kinds_;
+  std::vector<real_t> tolerances_;
+  std::vector<real_t> targetFractions_;
+  const RefinementPredictor<dimension>* predictor_;
+};
+
+#endif
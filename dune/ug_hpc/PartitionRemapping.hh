@@ -0,0 +1,240 @@
+#ifndef PARTITIONREMAPPING_H
+#define PARTITIONREMAPPING_H
+
+#include <dune/common/exceptions.hh>
+#include <dune/common/parallel/mpihelper.hh>
+#include <dune/grid/common/mcmgmapper.hh>
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <mpi.h>
+
+#include <dune/ug_hpc/PartitionConstraints.hh>
+
+
+// Assignment of part labels to ranks from the overlap matrix, overlap[r*nparts + l] being the load on rank r
+// labeled l, so that as much load as possible keeps its rank
+struct LabelAssignment {
+  enum Method {
+    None,    // use the labels as they are
+    Greedy,  // assign the largest overlaps first
+    Optimal  // maximize the retained load with the Hungarian method
+  };
+
+  static Method method(const std::string& name) {
+    if (name == "none")
+      return None;
+    if (name == "greedy")
+      return Greedy;
+    if (name == "optimal")
+      return Optimal;
+
+    DUNE_THROW(Dune::Exception, "Unknown remapping method " << name << ".");
+  }
+
+  // Computes the rank target[l] that receives label l
+  static void assign(const std::vector<double>& overlap, int size, int nparts, Method method, std::vector<int>& target) {
+    switch (method) {
+    case None:
+      for (int l = 0; l < nparts; ++l)
+	target[l] = l;
+      break;
+
+    case Greedy:
+      greedy(overlap, size, nparts, target);
+      break;
+
+    case Optimal:
+      hungarian(overlap, size, nparts, target);
+      break;
+    }
+  }
+
+  // As above, but label l may only go to rank r if group[l] == group[r], e.g. to keep parts with different
+  // target fractions on the ranks they were sized for.  Groups are given by their first member and need
+  // nparts == size; without groups, all labels and ranks form one.
+  static void assign(const std::vector<double>& overlap, int size, int nparts, Method method, const std::vector<int>& group,
+		     std::vector<int>& target) {
+    if (group.empty()) {
+      assign(overlap, size, nparts, method, target);
+      return;
+    }
+
+    if (nparts != size)
+      DUNE_THROW(Dune::Exception, "Grouped label assignment needs as many parts as ranks.");
+
+    for (int g = 0; g < nparts; ++g) {
+      std::vector<int> members;
+      for (int i = 0; i < nparts; ++i)
+	if (group[i] == g)
+	  members.push_back(i);
+
+      if (members.empty())
+	continue;
+
+      // Assign within the square submatrix of the group
+      const int n = members.size();
+      std::vector<double> groupOverlap(n*n);
+      for (int a = 0; a < n; ++a)
+	for (int b = 0; b < n; ++b)
+	  groupOverlap[a*n + b] = overlap[members[a]*nparts + members[b]];
+
+      std::vector<int> groupTarget(n);
+      assign(groupOverlap, n, n, method, groupTarget);
+
+      for (int b = 0; b < n; ++b)
+	target[members[b]] = members[groupTarget[b]];
+    }
+  }
+
+private:
+  // Visits the overlaps in descending order and assigns a label to a rank if both are still free
+  static void greedy(const std::vector<double>& overlap, int size, int nparts, std::vector<int>& target) {
+    std::vector<std::pair<double, int> > entries(size*nparts);
+    for (int i = 0; i < size*nparts; ++i)
+      entries[i] = std::make_pair(-overlap[i], i);
+
+    std::sort(entries.begin(), entries.end());
+
+    std::vector<bool> rankUsed(size, false), labelUsed(nparts, false);
+    for (size_t i = 0; i < entries.size(); ++i) {
+      const int r = entries[i].second / nparts, l = entries[i].second % nparts;
+
+      if (!rankUsed[r] && !labelUsed[l]) {
+	target[l] = r;
+	rankUsed[r] = labelUsed[l] = true;
+      }
+    }
+  }
+
+  // Hungarian method with potentials for the rectangular assignment problem of nparts labels to size >= nparts
+  // ranks, minimizing the negative overlap in O(nparts^2 * size)
+  static void hungarian(const std::vector<double>& overlap, int size, int nparts, std::vector<int>& target) {
+    const double inf = std::numeric_limits<double>::max();
+
+    // All arrays are 1-based, index 0 is a sentinel
+    std::vector<double> u(nparts+1, 0), v(size+1, 0);
+    std::vector<int> labelOfRank(size+1, 0), way(size+1, 0);
+
+    for (int l = 1; l <= nparts; ++l) {
+      labelOfRank[0] = l;
+      int r0 = 0;
+
+      std::vector<double> minv(size+1, inf);
+      std::vector<bool> used(size+1, false);
+
+      do {
+	used[r0] = true;
+	const int l0 = labelOfRank[r0];
+	double delta = inf;
+	int r1 = 0;
+
+	for (int r = 1; r <= size; ++r) {
+	  if (used[r])
+	    continue;
+
+	  const double cur = -overlap[(r-1)*nparts + (l0-1)] - u[l0] - v[r];
+	  if (cur < minv[r]) {
+	    minv[r] = cur;
+	    way[r] = r0;
+	  }
+
+	  if (minv[r] < delta) {
+	    delta = minv[r];
+	    r1 = r;
+	  }
+	}
+
+	for (int r = 0; r <= size; ++r) {
+	  if (used[r]) {
+	    u[labelOfRank[r]] += delta;
+	    v[r] -= delta;
+	  }
+	  else
+	    minv[r] -= delta;
+	}
+
+	r0 = r1;
+      } while (labelOfRank[r0] != 0);
+
+      do {
+	const int r1 = way[r0];
+	labelOfRank[r0] = labelOfRank[r1];
+	r0 = r1;
+      } while (r0 != 0);
+    }
+
+    for (int r = 1; r <= size; ++r)
+      if (labelOfRank[r] != 0)
+	target[labelOfRank[r]-1] = r-1;
+  }
+};
+
+
+// Relabels the parts returned by a partitioner so that as much load as possible stays on its current rank.
+// Partitioners only care about which elements end up together, not which rank a part is assigned to; any
+// permutation of the labels has the same edgecut and balance, but may migrate far fewer elements.
+template<class GridView>
+struct PartitionRemapping : public LabelAssignment {
+#if PARMETIS_MAJOR_VERSION < 4
+  typedef idxtype idx_t;
+#endif
+
+  typedef typename GridView::template Codim<0>::template Partition<Dune::Interior_Partition>::Iterator InteriorElementIterator;
+
+  // Relabels part in place (collective).  nparts is the number of labels, at most the number of ranks.
+  // The load of an element is its first constraint weight, or one if the constraints are unweighted.  Parts
+  // with different target fractions are not exchanged, so each keeps the rank it was sized for.  Returns the fraction of the load that stays on its rank after relabeling.
+  static double remap(const GridView& gv, std::vector<unsigned>& part, int nparts, Method method = Greedy,
+		      const PartitionConstraints<GridView>& constraints = PartitionConstraints<GridView>()) {
+    const int rank = gv.comm().rank();
+    const int size = gv.comm().size();
+
+    typedef Dune::MultipleCodimMultipleGeomTypeMapper<GridView, Dune::MCMGElementLayout> ElementMapper;
+    ElementMapper elementMapper(gv);
+
+    // Row of the overlap matrix: load of this rank's elements per new label
+    std::vector<double> row(nparts, 0);
+    std::vector<idx_t> w(constraints.ncon(), 1);
+
+    for (InteriorElementIterator eIt = gv.template begin<0, Dune::Interior_Partition>(); eIt != gv.template end<0, Dune::Interior_Partition>(); ++eIt) {
+      if (constraints.weighted())
+	constraints.weights(gv, *eIt, w.data());
+
+      row[part[elementMapper.map(*eIt)]] += w[0];
+    }
+
+    // Gather the overlap matrix, overlap[r*nparts + l] is the load on rank r labeled l
+    std::vector<double> overlap(rank == 0 ? size*nparts : 0);
+    MPI_Gather(row.data(), nparts, MPI_DOUBLE, overlap.data(), nparts, MPI_DOUBLE, 0, Dune::MPIHelper::getCommunicator());
+
+    // Rank that receives each label
+    std::vector<int> target(nparts);
+    double retained = 0, total = 0;
+
+    if (0 == rank) {
+      assign(overlap, size, nparts, method, constraints.targetGroups(nparts), target);
+
+      for (int l = 0; l < nparts; ++l)
+	retained += overlap[target[l]*nparts + l];
+      for (size_t i = 0; i < overlap.size(); ++i)
+	total += overlap[i];
+    }
+
+    gv.comm().broadcast(target.data(), nparts, 0);
+    gv.comm().broadcast(&retained, 1, 0);
+    gv.comm().broadcast(&total, 1, 0);
+
+    for (size_t i = 0; i < part.size(); ++i)
+      if (part[i] < static_cast<unsigned>(nparts))
+	part[i] = target[part[i]];
+
+    return (total > 0) ? retained / total : 1;
+  }
+};
+
+#endif
@@ -0,0 +1,226 @@
+#ifndef REFINEMENTINDICATOR_H
+#define REFINEMENTINDICATOR_H
+
+#include <dune/common/fvector.hh>
+#include <dune/grid/common/mcmgmapper.hh>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <dune/ug_hpc/Ball.hh>
+
+
+// Refinement indicators decide for blocks of interior leaf elements whether to refine, keep or coarsen them.
+// An indicator is any class with
+//
+//   void evaluate(const ElementBlock<dim>& block, int* decisions) const;
+//
+// writing one RefinementDecision per element of the block.  IndicatorMarking takes the indicator as a template
+// parameter, so evaluate() is inlined into the marking loop, and the block holds the element data in arrays,
+// so that the indicator's loop over the block can be vectorized.
+
+enum RefinementDecision {
+  Coarsen = -1,
+  Keep = 0,
+  Refine = 1
+};
+
+// Centers, levels and mapper indices of up to `capacity` elements, one array per coordinate
+template<int dim>
+struct ElementBlock {
+  enum {
+    capacity = 64
+  };
+
+  int size;
+  double center[dim][capacity];
+  int level[capacity];
+  int index[capacity];   // element mapper index, for indicators on data attached to the elements
+
+  Dune::FieldVector<double, dim> point(int i) const {
+    Dune::FieldVector<double, dim> x;
+    for (int j = 0; j < dim; ++j)
+      x[j] = center[j][i];
+
+    return x;
+  }
+};
+
+
+// Refines where |f| < epsilon and coarsens where |f| > coarsenFactor * epsilon, for a level set function f,
+// i.e. a function object with double operator()(const Dune::FieldVector<double, dim>&) const
+template<int dim, class LevelSet>
+struct LevelSetIndicator {
+  LevelSetIndicator(const LevelSet& f, double epsilon, double coarsenFactor = 1) :
+    f_(f), epsilon_(epsilon), coarsenDistance_(coarsenFactor * epsilon)
+  {}
+
+  void evaluate(const ElementBlock<dim>& block, int* decisions) const {
+    for (int i = 0; i < block.size; ++i) {
+      const double d = std::abs(f_(block.point(i)));
+      decisions[i] = (d < epsilon_) ? Refine : (d > coarsenDistance_) ? Coarsen : Keep;
+    }
+  }
+
+private:
+  LevelSet f_;
+  double epsilon_, coarsenDistance_;
+};
+
+// Level set of the ball surface
+template<int dim>
+struct BallLevelSet {
+  explicit BallLevelSet(const Ball<dim>& ball) : ball_(ball) {}
+
+  double operator()(const Dune::FieldVector<double, dim>& x) const {
+    return ball_.distanceTo(x);
+  }
+
+private:
+  const Ball<dim>& ball_;
+};
+
+// The driver's criterion: refine within epsilon of the ball surface.  Holds a reference to the ball, so it
+// follows the ball as it moves.
+template<int dim>
+struct BallIndicator : public LevelSetIndicator<dim, BallLevelSet<dim> > {
+  BallIndicator(const Ball<dim>& ball, double epsilon, double coarsenFactor = 1) :
+    LevelSetIndicator<dim, BallLevelSet<dim> >(BallLevelSet<dim>(ball), epsilon, coarsenFactor)
+  {}
+};
+
+
+// Gradient-based error estimator for a piecewise constant field u attached to the elements, indexed by the
+// element mapper: eta = h * max |u_e - u_n| / |x_e - x_n| over the neighbors n, with h the element diameter
+// estimated from its volume.  Elements with eta above refineFraction times the global maximum are refined,
+// those below coarsenFraction times the maximum coarsened.  The values of the ghost elements have to be up
+// to date; the estimates are computed in the constructor (collective), for the grid at that time.
+template<class GridView>
+class GradientIndicator {
+public:
+  typedef typename GridView::template Codim<0>::template Partition<Dune::Interior_Partition>::Iterator InteriorElementIterator;
+  typedef typename GridView::IntersectionIterator                                                      IntersectionIterator;
+
+  typedef Dune::MultipleCodimMultipleGeomTypeMapper<GridView, Dune::MCMGElementLayout> ElementMapper;
+
+  enum {
+    dimension = GridView::dimension
+  };
+
+  GradientIndicator(const GridView& gv, const std::vector<double>& u, double refineFraction = 0.5, double coarsenFraction = 0.1) :
+    eta_(u.size(), 0)
+  {
+    ElementMapper elementMapper(gv);
+    double maxEta = 0;
+
+    for (InteriorElementIterator eIt = gv.template begin<0, Dune::Interior_Partition>(); eIt != gv.template end<0, Dune::Interior_Partition>(); ++eIt) {
+      const int i = elementMapper.map(*eIt);
+      const Dune::FieldVector<double, dimension> center = eIt->geometry().center();
+
+      double gradient = 0;
+      for (IntersectionIterator iIt = gv.ibegin(*eIt); iIt != gv.iend(*eIt); ++iIt) {
+	if (!iIt->neighbor())
+	  continue;
+
+	const Dune::FieldVector<double, dimension> outsideCenter = iIt->outside()->geometry().center();
+	gradient = std::max(gradient, std::abs(u[i] - u[elementMapper.map(*iIt->outside())]) / (outsideCenter - center).two_norm());
+      }
+
+      eta_[i] = std::pow(eIt->geometry().volume(), 1. / dimension) * gradient;
+      maxEta = std::max(maxEta, eta_[i]);
+    }
+
+    maxEta = gv.comm().max(maxEta);
+    refineThreshold_ = refineFraction * maxEta;
+    coarsenThreshold_ = coarsenFraction * maxEta;
+  }
+
+  void evaluate(const ElementBlock<dimension>& block, int* decisions) const {
+    for (int i = 0; i < block.size; ++i) {
+      const double eta = eta_[block.index[i]];
+      decisions[i] = (eta > refineThreshold_) ? Refine : (eta < coarsenThreshold_) ? Coarsen : Keep;
+    }
+  }
+
+private:
+  std::vector<double> eta_;
+  double refineThreshold_, coarsenThreshold_;
+};
+
+
+// Marks the interior leaf elements of a grid by an indicator.  The first sweep fills blocks with the element
+// data and evaluates them, the second marks the elements in the same traversal order, so no entity pointers
+// have to be kept.  Refinement is limited to maxLevel; refine or coarsen decisions can be ignored, e.g. to
+// refine towards a target without coarsening in between.
+template<class Grid>
+class IndicatorMarking {
+public:
+  typedef typename Grid::LeafGridView GridView;
+
+  typedef typename GridView::template Codim<0>::template Partition<Dune::Interior_Partition>::Iterator InteriorElementIterator;
+
+  typedef Dune::MultipleCodimMultipleGeomTypeMapper<GridView, Dune::MCMGElementLayout> ElementMapper;
+
+  enum {
+    dimension = Grid::dimension
+  };
+
+  // Elements marked for refinement and coarsening on this rank
+  struct Counts {
+    long refined, coarsened;
+  };
+
+  template<class Indicator>
+  static Counts mark(Grid& grid, const Indicator& indicator, int maxLevel, bool refine = true, bool coarsen = true) {
+    const GridView gv = grid.leafGridView();
+    ElementMapper elementMapper(gv);
+
+    std::vector<int> decisions;
+    ElementBlock<dimension> block;
+    block.size = 0;
+
+    for (InteriorElementIterator eIt = gv.template begin<0, Dune::Interior_Partition>(); eIt != gv.template end<0, Dune::Interior_Partition>(); ++eIt) {
+      const Dune::FieldVector<double, dimension> center = eIt->geometry().center();
+
+      for (int j = 0; j < dimension; ++j)
+	block.center[j][block.size] = center[j];
+      block.level[block.size] = eIt->level();
+      block.index[block.size] = elementMapper.map(*eIt);
+
+      if (++block.size == ElementBlock<dimension>::capacity)
+	evaluate(indicator, block, decisions);
+    }
+
+    if (block.size > 0)
+      evaluate(indicator, block, decisions);
+
+    Counts counts = {0, 0};
+    size_t i = 0;
+
+    for (InteriorElementIterator eIt = gv.template begin<0, Dune::Interior_Partition>(); eIt != gv.template end<0, Dune::Interior_Partition>(); ++eIt, ++i) {
+      if (refine && decisions[i] == Refine && eIt->level() < maxLevel) {
+	grid.mark(1, *eIt);
+	++counts.refined;
+      }
+      else if (coarsen && decisions[i] == Coarsen && eIt->level() > 0) {
+	grid.mark(-1, *eIt);
+	++counts.coarsened;
+      }
+    }
+
+    return counts;
+  }
+
+private:
+  template<class Indicator>
+  static void evaluate(const Indicator& indicator, ElementBlock<dimension>& block, std::vector<int>& decisions) {
+    const size_t first = decisions.size();
+    decisions.resize(first + block.size);
+
+    indicator.evaluate(block, &decisions[first]);
+    block.size = 0;
+  }
+};
+
+#endif
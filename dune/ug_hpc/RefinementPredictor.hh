@@ -0,0 +1,95 @@
+#ifndef REFINEMENTPREDICTOR_H
+#define REFINEMENTPREDICTOR_H
+
+#include <dune/common/fvector.hh>
+
+#include <algorithm>
+#include <vector>
+
+#include <dune/ug_hpc/Ball.hh>
+
+
+// Position of the ball center in every step, either given by a list of waypoints or by a constant displacement
+// per step.  After the last waypoint, the ball keeps moving by the displacement.
+template<int dim>
+class Trajectory {
+public:
+  typedef Dune::FieldVector<double, dim> GlobalVector;
+
+  Trajectory(const GlobalVector& start, const GlobalVector& displacement) : displacement_(displacement) {
+    waypoints_.push_back(start);
+  }
+
+  // waypoints[s] is the center in step s+1, the start is the center in step 0
+  void setWaypoints(const std::vector<GlobalVector>& waypoints) {
+    waypoints_.resize(1);
+    waypoints_.insert(waypoints_.end(), waypoints.begin(), waypoints.end());
+  }
+
+  GlobalVector center(size_t step) const {
+    if (step < waypoints_.size())
+      return waypoints_[step];
+
+    GlobalVector c = displacement_;
+    c *= step - waypoints_.size() + 1;
+    c += waypoints_.back();
+
+    return c;
+  }
+
+private:
+  GlobalVector displacement_;
+  std::vector<GlobalVector> waypoints_;
+};
+
+
+// Predicts the load of the current leaf elements after the next step, in which the grid is coarsened to the
+// macro level and refined `levels` times within epsilon of the moved ball.  An element intersecting the next
+// refinement band will be split into 2^(dim*(levels-l)) leaves, where l is its level; any other element will be
+// merged back into its macro element and accounts for 2^(-dim*l) of it.  Loads are scaled by 2^(dim*levels) to
+// keep them integral.
+template<int dim>
+class RefinementPredictor {
+public:
+  RefinementPredictor(const Trajectory<dim>& trajectory, double radius, double epsilon, int levels) :
+    trajectory_(trajectory), next_(trajectory.center(1), radius), epsilon_(epsilon), levels_(levels)
+  {}
+
+  // Predict for the transition from step to step+1
+  void setStep(size_t step) {
+    next_.center = trajectory_.center(step + 1);
+  }
+
+  const Ball<dim>& nextBall() const {
+    return next_;
+  }
+
+  template<class Element>
+  long predictedLoad(const Element& element) const {
+    const int l = std::min(element.level(), levels_);
+    const long share = 1L << (dim*(levels_ - l));
+
+    return inNextBand(element) ? share << (dim*levels_) : share;
+  }
+
+  // True if refinement around the next ball position will reach into the element
+  template<class Element>
+  bool inNextBand(const Element& element) const {
+    const typename Element::Geometry geometry = element.geometry();
+    const Dune::FieldVector<double, dim> center = geometry.center();
+
+    double size = 0;
+    for (int i = 0; i < geometry.corners(); ++i)
+      size = std::max(size, (geometry.corner(i) - center).two_norm());
+
+    return next_.distanceTo(center) < epsilon_ + size;
+  }
+
+private:
+  const Trajectory<dim>& trajectory_;
+  Ball<dim> next_;
+  double epsilon_;
+  int levels_;
+};
+
+#endif
@@ -0,0 +1,186 @@
+#ifndef SPACEFILLINGCURVEORDERING_H
+#define SPACEFILLINGCURVEORDERING_H
+
+#include <dune/common/fvector.hh>
+#include <dune/grid/common/mcmgmapper.hh>
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+
+
+// Local renumbering of the leaf elements and vertices along a space-filling curve (Hilbert in 2d, Morton
+// otherwise) through the element centers.  Interior elements come first in curve order, followed by the ghosts;
+// vertices are numbered in the order they are first touched by the elements.  Arrays laid out by these indices
+// are walked with good locality by loops over elements().
+//
+// The numbering is only valid for the grid it was computed on; call update() after every adapt() and loadBalance().
+template<class GridView>
+class SpaceFillingCurveOrdering {
+public:
+  typedef typename GridView::template Codim<0>::Iterator                                               ElementIterator;
+  typedef typename GridView::template Codim<0>::template Partition<Dune::Interior_Partition>::Iterator InteriorElementIterator;
+  typedef typename GridView::template Codim<0>::Entity                                                 Element;
+  typedef typename GridView::template Codim<0>::EntitySeed                                             ElementSeed;
+
+  enum {
+    dimension = GridView::dimension
+  };
+
+  typedef Dune::MultipleCodimMultipleGeomTypeMapper<GridView, Dune::MCMGElementLayout> ElementMapper;
+  typedef Dune::MultipleCodimMultipleGeomTypeMapper<GridView, Dune::MCMGVertexLayout>  VertexMapper;
+
+
+  explicit SpaceFillingCurveOrdering(const GridView& gv) : gv_(gv), elementMapper_(gv_), vertexMapper_(gv_) {
+    update();
+  }
+
+  void update() {
+    elementMapper_.update();
+    vertexMapper_.update();
+
+    // Bounding box of the interior element centers
+    Dune::FieldVector<double, dimension> lower(std::numeric_limits<double>::max()), upper(-std::numeric_limits<double>::max());
+
+    for (InteriorElementIterator eIt = gv_.template begin<0, Dune::Interior_Partition>(); eIt != gv_.template end<0, Dune::Interior_Partition>(); ++eIt) {
+      const Dune::FieldVector<double, dimension> center = eIt->geometry().center();
+
+      for (int j = 0; j < dimension; ++j) {
+	lower[j] = std::min(lower[j], center[j]);
+	upper[j] = std::max(upper[j], center[j]);
+      }
+    }
+
+    // Sort the interior elements by curve key
+    std::vector<std::pair<uint64_t, ElementSeed> > keys;
+    for (InteriorElementIterator eIt = gv_.template begin<0, Dune::Interior_Partition>(); eIt != gv_.template end<0, Dune::Interior_Partition>(); ++eIt)
+      keys.push_back(std::make_pair(key(eIt->geometry().center(), lower, upper), eIt->seed()));
+
+    std::stable_sort(keys.begin(), keys.end(), CompareKeys());
+
+    elements_.resize(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+      elements_[i] = keys[i].second;
+
+    // Number interior elements in curve order, then the ghosts in traversal order
+    elementIndex_.assign(elementMapper_.size(), -1);
+
+    int next = 0;
+    for (size_t i = 0; i < elements_.size(); ++i)
+      elementIndex_[elementMapper_.map(*gv_.grid().entityPointer(elements_[i]))] = next++;
+
+    for (ElementIterator eIt = gv_.template begin<0>(); eIt != gv_.template end<0>(); ++eIt)
+      if (elementIndex_[elementMapper_.map(*eIt)] < 0)
+	elementIndex_[elementMapper_.map(*eIt)] = next++;
+
+    // Number vertices by first touch of the interior elements, then the remaining ones
+    vertexIndex_.assign(vertexMapper_.size(), -1);
+
+    next = 0;
+    for (size_t i = 0; i < elements_.size(); ++i)
+      numberVertices(*gv_.grid().entityPointer(elements_[i]), next);
+
+    for (ElementIterator eIt = gv_.template begin<0>(); eIt != gv_.template end<0>(); ++eIt)
+      numberVertices(*eIt, next);
+  }
+
+  // Interior elements in curve order
+  const std::vector<ElementSeed>& elements() const {
+    return elements_;
+  }
+
+  // Curve position of an element, indexed by the element mapper; interior elements get 0, ..., elements().size()-1
+  const std::vector<int>& elementPermutation() const {
+    return elementIndex_;
+  }
+
+  // First-touch position of a vertex, indexed by the vertex mapper
+  const std::vector<int>& vertexPermutation() const {
+    return vertexIndex_;
+  }
+
+  int elementIndex(const Element& element) const {
+    return elementIndex_[elementMapper_.map(element)];
+  }
+
+private:
+  struct CompareKeys {
+    bool operator()(const std::pair<uint64_t, ElementSeed>& a, const std::pair<uint64_t, ElementSeed>& b) const {
+      return a.first < b.first;
+    }
+  };
+
+  void numberVertices(const Element& element, int& next) {
+    const int corners = element.geometry().corners();
+
+    for (int i = 0; i < corners; ++i) {
+      int& index = vertexIndex_[vertexMapper_.map(element, i, dimension)];
+      if (index < 0)
+	index = next++;
+    }
+  }
+
+  // Curve key of x after scaling the bounding box to the unit cube
+  static uint64_t key(const Dune::FieldVector<double, dimension>& x,
+		      const Dune::FieldVector<double, dimension>& lower, const Dune::FieldVector<double, dimension>& upper) {
+    const int bits = (dimension == 2) ? 31 : 63 / dimension;
+    const double cells = double(uint64_t(1) << bits);
+
+    uint64_t coordinate[dimension];
+    for (int j = 0; j < dimension; ++j) {
+      const double extent = upper[j] - lower[j];
+      const double t = (extent > 0) ? (x[j] - lower[j]) / extent : 0;
+
+      coordinate[j] = std::min(static_cast<uint64_t>(t * cells), (uint64_t(1) << bits) - 1);
+    }
+
+    return (dimension == 2) ? hilbert(coordinate[0], coordinate[1], bits) : morton(coordinate, bits);
+  }
+
+  // Distance of (x, y) along the Hilbert curve through a 2^bits x 2^bits grid
+  static uint64_t hilbert(uint64_t x, uint64_t y, int bits) {
+    const uint64_t n = uint64_t(1) << bits;
+
+    uint64_t d = 0;
+    for (uint64_t s = n/2; s > 0; s /= 2) {
+      const uint64_t rx = (x & s) ? 1 : 0;
+      const uint64_t ry = (y & s) ? 1 : 0;
+
+      d += s * s * ((3 * rx) ^ ry);
+
+      // Rotate the quadrant
+      if (0 == ry) {
+	if (1 == rx) {
+	  x = n-1 - x;
+	  y = n-1 - y;
+	}
+
+	std::swap(x, y);
+      }
+    }
+
+    return d;
+  }
+
+  // Interleaves the bits of all coordinates
+  static uint64_t morton(const uint64_t* coordinate, int bits) {
+    uint64_t d = 0;
+    for (int b = bits-1; b >= 0; --b)
+      for (int j = 0; j < dimension; ++j)
+	d = (d << 1) | ((coordinate[j] >> b) & 1);
+
+    return d;
+  }
+
+  const GridView gv_;
+  ElementMapper elementMapper_;
+  VertexMapper vertexMapper_;
+
+  std::vector<ElementSeed> elements_;
+  std::vector<int> elementIndex_, vertexIndex_;
+};
+
+#endif
@@ -1,6 +1,8 @@
-#ifndef DUNE_ug_hpc.hh
-#define DUNE_ug_hpc.hh
+#ifndef DUNE_UG_HPC_HH
+#define DUNE_UG_HPC_HH
 
-// add your classes here
+// Dynamic load balancing of distributed grids: DynamicLoadBalancer and the partitioners, constraints and
+// index it is built from
+#include <dune/ug_hpc/DynamicLoadBalancer.hh>
 
-#endif // DUNE_ug_hpc.hh
+#endif // DUNE_UG_HPC_HH
@@ -6,7 +6,34 @@ dnl -*- autoconf -*-
 # Additional checks needed to build dune-ug-hpc
 # This macro should be invoked by every module which depends on dune-ug-hpc, as
 # well as by dune-ug-hpc itself
-AC_DEFUN([DUNE_UG_HPC_CHECKS])
+AC_DEFUN([DUNE_UG_HPC_CHECKS],
+[
+  # AsyncRepartitioner runs std::thread, which needs the compiler's thread
+  # support: -pthread if the compiler accepts it, -lpthread otherwise
+  AC_LANG_PUSH([C++])
+  AC_MSG_CHECKING([for the flags needed by std::thread])
+  PTHREAD_CFLAGS=""
+  PTHREAD_LIBS=""
+  ug_hpc_save_CXXFLAGS="$CXXFLAGS"
+  ug_hpc_save_LIBS="$LIBS"
+  for ug_hpc_flag in -pthread -lpthread; do
+    CXXFLAGS="$ug_hpc_save_CXXFLAGS"
+    LIBS="$ug_hpc_save_LIBS $ug_hpc_flag"
+    AS_IF([test "x$ug_hpc_flag" = "x-pthread"], [CXXFLAGS="$CXXFLAGS -pthread"])
+    AC_LINK_IFELSE([AC_LANG_PROGRAM([[#include <pthread.h>
+static void* run(void*) { return 0; }]],
+                                    [[pthread_t t; pthread_create(&t, 0, run, 0); pthread_join(t, 0);]])],
+                   [AS_IF([test "x$ug_hpc_flag" = "x-pthread"], [PTHREAD_CFLAGS="-pthread"])
+                    PTHREAD_LIBS="$ug_hpc_flag"
+                    break])
+  done
+  CXXFLAGS="$ug_hpc_save_CXXFLAGS"
+  LIBS="$ug_hpc_save_LIBS"
+  AC_LANG_POP([C++])
+  AC_MSG_RESULT([$PTHREAD_CFLAGS $PTHREAD_LIBS])
+  AC_SUBST(PTHREAD_CFLAGS)
+  AC_SUBST(PTHREAD_LIBS)
+])
 
 # Additional checks needed to find dune-ug-hpc
 # This macro should be invoked by every module which depends on dune-ug-hpc, but
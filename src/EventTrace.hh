@@ -0,0 +1,195 @@
+#ifndef EVENTTRACE_H
+#define EVENTTRACE_H
+
+#include <dune/common/exceptions.hh>
+#include <dune/common/parallel/mpihelper.hh>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <mpi.h>
+
+
+// Timeline of the phases of every rank, written as a Chrome trace (chrome://tracing, Perfetto) in which every
+// rank is a process.  Events are kept in a ring buffer of fixed capacity that is allocated up front, so recording
+// costs two MPI_Wtime calls and no allocation; once the buffer is full the oldest events are overwritten.
+//
+// Only the thread that created the trace records events, others (e.g. the asynchronous repartitioner) are
+// ignored.  A disabled trace records nothing, so the calls can stay in the code.
+class EventTrace {
+public:
+  // Collective if enabled: the ranks agree on the time origin after a barrier
+  EventTrace(bool enabled = false, size_t capacity = 1 << 16) :
+    enabled_(enabled), thread_(std::this_thread::get_id()), events_(enabled ? std::max<size_t>(capacity, 1) : 0), next_(0), recorded_(0), origin_(0)
+  {
+    if (enabled_) {
+      open_.reserve(64);
+
+      MPI_Barrier(Dune::MPIHelper::getCommunicator());
+      origin_ = MPI_Wtime();
+    }
+  }
+
+  bool enabled() const {
+    return enabled_;
+  }
+
+  // Starts an event; events nest, end() closes the latest one.  name and category must be string literals.
+  void begin(const char* name, const char* category = "phase") {
+    if (!recording())
+      return;
+
+    const OpenEvent e = {name, category, MPI_Wtime()};
+    open_.push_back(e);
+  }
+
+  void end() {
+    if (!recording() || open_.empty())
+      return;
+
+    const OpenEvent& e = open_.back();
+    record(e.name, e.category, e.begin, MPI_Wtime());
+    open_.pop_back();
+  }
+
+  // Records an event whose times were taken by the caller
+  void record(const char* name, const char* category, double begin, double end) {
+    if (!recording())
+      return;
+
+    Event& e = events_[next_];
+    e.name = name;
+    e.category = category;
+    e.begin = begin;
+    e.end = end;
+
+    next_ = (next_ + 1) % events_.size();
+    ++recorded_;
+  }
+
+  // Number of events lost because the ring buffer was full
+  size_t dropped() const {
+    return recorded_ > events_.size() ? recorded_ - events_.size() : 0;
+  }
+
+  // Collective: gathers the events of all ranks on rank 0, which writes them to fileName
+  void write(const std::string& fileName) {
+    if (!enabled_)
+      return;
+
+    // Do not trace the collectives below
+    enabled_ = false;
+
+    int rank, size;
+    MPI_Comm_rank(Dune::MPIHelper::getCommunicator(), &rank);
+    MPI_Comm_size(Dune::MPIHelper::getCommunicator(), &size);
+
+    std::ostringstream json;
+    json.precision(15);
+
+    json << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << rank << ",\"tid\":0,\"args\":{\"name\":\"rank " << rank << "\"}},\n"
+	 << "{\"name\":\"process_sort_index\",\"ph\":\"M\",\"pid\":" << rank << ",\"tid\":0,\"args\":{\"sort_index\":" << rank << "}}";
+
+    // Oldest event first
+    const size_t n = std::min(recorded_, events_.size());
+    const size_t first = recorded_ > events_.size() ? next_ : 0;
+
+    for (size_t i = 0; i < n; ++i) {
+      const Event& e = events_[(first + i) % events_.size()];
+
+      json << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"" << e.category << "\",\"ph\":\"X\",\"pid\":" << rank
+	   << ",\"tid\":0,\"ts\":" << 1e6*(e.begin - origin_) << ",\"dur\":" << 1e6*(e.end - e.begin) << "}";
+    }
+
+    if (dropped() > 0)
+      json << ",\n{\"name\":\"dropped " << dropped() << " events\",\"ph\":\"i\",\"s\":\"p\",\"pid\":" << rank
+	   << ",\"tid\":0,\"ts\":0}";
+
+    const std::string local = json.str();
+
+    // Gather the text on rank 0
+    int length = local.size();
+    std::vector<int> lengths(size), displs(size);
+    MPI_Gather(&length, 1, MPI_INT, lengths.data(), 1, MPI_INT, 0, Dune::MPIHelper::getCommunicator());
+
+    int total = 0;
+    for (int r = 0; r < size; ++r) {
+      displs[r] = total;
+      total += lengths[r];
+    }
+
+    std::vector<char> text(rank == 0 ? total : 0);
+    MPI_Gatherv(const_cast<char*>(local.data()), length, MPI_CHAR, text.data(), lengths.data(), displs.data(), MPI_CHAR, 0, Dune::MPIHelper::getCommunicator());
+
+    if (0 == rank) {
+      std::ofstream out(fileName.c_str());
+      if (!out)
+	DUNE_THROW(Dune::IOError, "Could not open " << fileName << " for writing.");
+
+      out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+      for (int r = 0; r < size; ++r) {
+	if (r > 0)
+	  out << ",\n";
+	out.write(text.data() + displs[r], lengths[r]);
+      }
+      out << "\n]}\n";
+    }
+  }
+
+  // Trace the MPI wrappers in EventTraceMPI.cc record to, NULL if they should not record anything
+  static EventTrace*& global() {
+    static EventTrace* trace = NULL;
+    return trace;
+  }
+
+private:
+  struct Event {
+    const char* name;
+    const char* category;
+    double begin, end;
+  };
+
+  struct OpenEvent {
+    const char* name;
+    const char* category;
+    double begin;
+  };
+
+  bool recording() const {
+    return enabled_ && std::this_thread::get_id() == thread_;
+  }
+
+  bool enabled_;
+  std::thread::id thread_;
+
+  std::vector<Event> events_;
+  size_t next_, recorded_;
+  std::vector<OpenEvent> open_;
+
+  double origin_;
+};
+
+
+// Records the lifetime of a scope as an event
+class ScopedEvent {
+public:
+  ScopedEvent(EventTrace& trace, const char* name, const char* category = "phase") : trace_(trace) {
+    trace_.begin(name, category);
+  }
+
+  ~ScopedEvent() {
+    trace_.end();
+  }
+
+private:
+  ScopedEvent(const ScopedEvent&);
+  ScopedEvent& operator=(const ScopedEvent&);
+
+  EventTrace& trace_;
+};
+
+#endif
@@ -0,0 +1,131 @@
+// Wrappers around the blocking MPI calls and MPI_Test, using the MPI profiling interface, that record the time
+// spent in them to EventTrace::global().  They also see the calls made by ParMETIS and UG, so the timeline shows which ranks
+// wait in which collective.  Linking this file is enough, the wrappers only record while a trace is installed.
+
+#include <mpi.h>
+
+#include "EventTrace.hh"
+
+#if MPI_VERSION >= 3
+#define EVENTTRACE_CONST const
+#else
+#define EVENTTRACE_CONST
+#endif
+
+namespace {
+
+  // Times a PMPI call and records it as an event of category "mpi"
+  class MPIEvent {
+  public:
+    explicit MPIEvent(const char* name) : name_(name), trace_(EventTrace::global()), begin_(trace_ ? MPI_Wtime() : 0) {}
+
+    ~MPIEvent() {
+      if (trace_)
+	trace_->record(name_, "mpi", begin_, MPI_Wtime());
+    }
+
+  private:
+    const char* name_;
+    EventTrace* trace_;
+    double begin_;
+  };
+
+}
+
+
+extern "C" {
+
+  int MPI_Barrier(MPI_Comm comm) {
+    MPIEvent e("MPI_Barrier");
+    return PMPI_Barrier(comm);
+  }
+
+  int MPI_Wait(MPI_Request* request, MPI_Status* status) {
+    MPIEvent e("MPI_Wait");
+    return PMPI_Wait(request, status);
+  }
+
+  int MPI_Waitall(int count, MPI_Request* requests, MPI_Status* statuses) {
+    MPIEvent e("MPI_Waitall");
+    return PMPI_Waitall(count, requests, statuses);
+  }
+
+  int MPI_Test(MPI_Request* request, int* flag, MPI_Status* status) {
+    MPIEvent e("MPI_Test");
+    return PMPI_Test(request, flag, status);
+  }
+
+  int MPI_Recv(void* buf, int count, MPI_Datatype type, int source, int tag, MPI_Comm comm, MPI_Status* status) {
+    MPIEvent e("MPI_Recv");
+    return PMPI_Recv(buf, count, type, source, tag, comm, status);
+  }
+
+  int MPI_Bcast(void* buf, int count, MPI_Datatype type, int root, MPI_Comm comm) {
+    MPIEvent e("MPI_Bcast");
+    return PMPI_Bcast(buf, count, type, root, comm);
+  }
+
+  int MPI_Reduce(EVENTTRACE_CONST void* sendbuf, void* recvbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm) {
+    MPIEvent e("MPI_Reduce");
+    return PMPI_Reduce(sendbuf, recvbuf, count, type, op, root, comm);
+  }
+
+  int MPI_Allreduce(EVENTTRACE_CONST void* sendbuf, void* recvbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm) {
+    MPIEvent e("MPI_Allreduce");
+    return PMPI_Allreduce(sendbuf, recvbuf, count, type, op, comm);
+  }
+
+  int MPI_Scan(EVENTTRACE_CONST void* sendbuf, void* recvbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm) {
+    MPIEvent e("MPI_Scan");
+    return PMPI_Scan(sendbuf, recvbuf, count, type, op, comm);
+  }
+
+  int MPI_Gather(EVENTTRACE_CONST void* sendbuf, int sendcount, MPI_Datatype sendtype,
+		 void* recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    MPIEvent e("MPI_Gather");
+    return PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+  }
+
+  int MPI_Gatherv(EVENTTRACE_CONST void* sendbuf, int sendcount, MPI_Datatype sendtype,
+		  void* recvbuf, EVENTTRACE_CONST int* recvcounts, EVENTTRACE_CONST int* displs, MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    MPIEvent e("MPI_Gatherv");
+    return PMPI_Gatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, root, comm);
+  }
+
+  int MPI_Scatter(EVENTTRACE_CONST void* sendbuf, int sendcount, MPI_Datatype sendtype,
+		  void* recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    MPIEvent e("MPI_Scatter");
+    return PMPI_Scatter(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+  }
+
+  int MPI_Scatterv(EVENTTRACE_CONST void* sendbuf, EVENTTRACE_CONST int* sendcounts, EVENTTRACE_CONST int* displs, MPI_Datatype sendtype,
+		   void* recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    MPIEvent e("MPI_Scatterv");
+    return PMPI_Scatterv(sendbuf, sendcounts, displs, sendtype, recvbuf, recvcount, recvtype, root, comm);
+  }
+
+  int MPI_Allgather(EVENTTRACE_CONST void* sendbuf, int sendcount, MPI_Datatype sendtype,
+		    void* recvbuf, int recvcount, MPI_Datatype recvtype, MPI_Comm comm) {
+    MPIEvent e("MPI_Allgather");
+    return PMPI_Allgather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+  }
+
+  int MPI_Allgatherv(EVENTTRACE_CONST void* sendbuf, int sendcount, MPI_Datatype sendtype,
+		     void* recvbuf, EVENTTRACE_CONST int* recvcounts, EVENTTRACE_CONST int* displs, MPI_Datatype recvtype, MPI_Comm comm) {
+    MPIEvent e("MPI_Allgatherv");
+    return PMPI_Allgatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, comm);
+  }
+
+  int MPI_Alltoall(EVENTTRACE_CONST void* sendbuf, int sendcount, MPI_Datatype sendtype,
+		   void* recvbuf, int recvcount, MPI_Datatype recvtype, MPI_Comm comm) {
+    MPIEvent e("MPI_Alltoall");
+    return PMPI_Alltoall(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+  }
+
+  int MPI_Alltoallv(EVENTTRACE_CONST void* sendbuf, EVENTTRACE_CONST int* sendcounts, EVENTTRACE_CONST int* sdispls, MPI_Datatype sendtype,
+		    void* recvbuf, EVENTTRACE_CONST int* recvcounts, EVENTTRACE_CONST int* rdispls, MPI_Datatype recvtype, MPI_Comm comm) {
+    MPIEvent e("MPI_Alltoallv");
+    return PMPI_Alltoallv(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm);
+  }
+
+}
@@ -0,0 +1,205 @@
+#ifndef INSITUOUTPUT_H
+#define INSITUOUTPUT_H
+
+#include <dune/common/exceptions.hh>
+#include <dune/common/fvector.hh>
+#include <dune/common/parallel/mpihelper.hh>
+#include <dune/geometry/referenceelements.hh>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+
+#include <dune/ug_hpc/Ball.hh>
+
+
+// Elements within a distance of the ball surface, i.e. the refinement front
+template<int dim>
+struct BallFront {
+  BallFront(const Ball<dim>& ball, double distance) : ball_(ball), distance_(distance) {}
+
+  template<class Element>
+  bool operator()(const Element& element) const {
+    return ball_.distanceTo(element.geometry().center()) < distance_;
+  }
+
+private:
+  const Ball<dim>& ball_;
+  double distance_;
+};
+
+// Elements that have been refined at least once
+struct RefinedFront {
+  template<class Element>
+  bool operator()(const Element& element) const {
+    return element.level() > 0;
+  }
+};
+
+
+// Reduced output computed in parallel instead of writing the whole leaf grid: the interior elements selected by
+// a predicate (center, level, quality and rank) and, for all interior elements, the number per rank and level
+// and a histogram of the element quality per level.  Rank 0 writes three CSV files,
+//   <prefix>_front_<step>.csv   one line per selected element,
+//   <prefix>_levels.csv         step, rank, level, elements,
+//   <prefix>_quality.csv        step, level, lower and upper bound of the quality bin, elements,
+// the latter two are appended to in every step.  The volume scales with the selected region and the number of
+// ranks and levels, not with the grid.
+template<class GridView>
+class InSituOutput {
+public:
+  typedef typename GridView::template Codim<0>::template Partition<Dune::Interior_Partition>::Iterator InteriorElementIterator;
+  typedef typename GridView::template Codim<0>::Entity                                                 Element;
+
+  enum {
+    dimension = GridView::dimension
+  };
+
+  InSituOutput(const std::string& prefix, int bins = 10) : prefix_(prefix), bins_(bins), first_(true) {}
+
+  // Collective: writes the summaries of step and the elements selected by front
+  template<class Predicate>
+  void write(const GridView& gv, int step, const Predicate& front) {
+    const int rank = gv.comm().rank();
+    const int size = gv.comm().size();
+
+    int maxLevel = 0;
+    for (InteriorElementIterator eIt = gv.template begin<0, Dune::Interior_Partition>(); eIt != gv.template end<0, Dune::Interior_Partition>(); ++eIt)
+      maxLevel = std::max(maxLevel, eIt->level());
+    maxLevel = gv.comm().max(maxLevel);
+
+    const int numLevels = maxLevel + 1;
+
+    // Counts per level and quality histograms per level of this rank, and the selected elements
+    std::vector<double> levels(numLevels, 0), histogram(numLevels*bins_, 0), selected;
+
+    for (InteriorElementIterator eIt = gv.template begin<0, Dune::Interior_Partition>(); eIt != gv.template end<0, Dune::Interior_Partition>(); ++eIt) {
+      const int l = eIt->level();
+      const double q = quality(*eIt);
+
+      ++levels[l];
+      ++histogram[l*bins_ + std::min(static_cast<int>(q*bins_), bins_-1)];
+
+      if (front(*eIt)) {
+	const Dune::FieldVector<double, dimension> center = eIt->geometry().center();
+
+	for (int j = 0; j < dimension; ++j)
+	  selected.push_back(center[j]);
+	selected.push_back(l);
+	selected.push_back(q);
+	selected.push_back(rank);
+      }
+    }
+
+    // Element counts of all ranks and the global histogram
+    std::vector<double> allLevels(rank == 0 ? size*numLevels : 0);
+    gv.comm().gather(levels.data(), allLevels.data(), numLevels, 0);
+
+    gv.comm().sum(histogram.data(), histogram.size());
+
+    // Selected elements, gathered on rank 0
+    int count = selected.size();
+    std::vector<int> counts(size), displs(size);
+    gv.comm().allgather(&count, 1, counts.data());
+
+    int total = 0;
+    for (int r = 0; r < size; ++r) {
+      displs[r] = total;
+      total += counts[r];
+    }
+
+    std::vector<double> allSelected(rank == 0 ? total : 0);
+    MPI_Gatherv(selected.data(), count, MPI_DOUBLE, allSelected.data(), counts.data(), displs.data(), MPI_DOUBLE, 0,
+		Dune::MPIHelper::getCommunicator());
+
+    if (0 != rank)
+      return;
+
+    const std::ios::openmode mode = first_ ? std::ios::out : std::ios::app;
+
+    std::ofstream levelsFile(fileName("levels").c_str(), mode);
+    std::ofstream qualityFile(fileName("quality").c_str(), mode);
+    std::ofstream frontFile(fileName("front_" + toString(step)).c_str());
+
+    if (!levelsFile || !qualityFile || !frontFile)
+      DUNE_THROW(Dune::IOError, "Could not open the in-situ output files " << prefix_ << "_*.csv for writing.");
+
+    if (first_) {
+      levelsFile << "step,rank,level,elements\n";
+      qualityFile << "step,level,lower,upper,elements\n";
+      first_ = false;
+    }
+
+    for (int r = 0; r < size; ++r)
+      for (int l = 0; l < numLevels; ++l)
+	levelsFile << step << ',' << r << ',' << l << ',' << allLevels[r*numLevels + l] << '\n';
+
+    for (int l = 0; l < numLevels; ++l)
+      for (int b = 0; b < bins_; ++b)
+	qualityFile << step << ',' << l << ',' << double(b)/bins_ << ',' << double(b+1)/bins_ << ',' << histogram[l*bins_ + b] << '\n';
+
+    const char* coordinates[3] = {"x", "y", "z"};
+    for (int j = 0; j < dimension; ++j)
+      frontFile << coordinates[j] << ',';
+    frontFile << "level,quality,rank\n";
+
+    const int values = dimension + 3;
+    for (int i = 0; i < total; i += values) {
+      for (int j = 0; j < dimension; ++j)
+	frontFile << allSelected[i+j] << ',';
+      frontFile << allSelected[i+dimension] << ',' << allSelected[i+dimension+1] << ',' << allSelected[i+dimension+2] << '\n';
+    }
+  }
+
+  // Shape quality in (0, 1], 1 for the regular simplex or cube: the volume relative to that of the regular
+  // element whose edges have the root mean square edge length of element
+  static double quality(const Element& element) {
+    const typename Element::Geometry geometry = element.geometry();
+    const Dune::ReferenceElement<double, dimension>& reference = Dune::ReferenceElements<double, dimension>::general(element.type());
+
+    const int edges = reference.size(dimension-1);
+    double sumSquares = 0;
+
+    for (int i = 0; i < edges; ++i) {
+      const int a = reference.subEntity(i, dimension-1, 0, dimension);
+      const int b = reference.subEntity(i, dimension-1, 1, dimension);
+
+      sumSquares += (geometry.corner(a) - geometry.corner(b)).two_norm2();
+    }
+
+    const double l = std::sqrt(sumSquares / edges);
+
+    // Volume of the regular element with edge length one
+    double regular = 1;
+    if (element.type().isSimplex()) {
+      for (int k = 2; k <= dimension; ++k)
+	regular /= k;
+      regular *= std::sqrt((dimension + 1) / double(1 << dimension));
+    }
+
+    return std::min(geometry.volume() / (regular * std::pow(l, dimension)), 1.);
+  }
+
+private:
+  static std::string toString(int i) {
+    std::ostringstream s;
+    s << i;
+
+    return s.str();
+  }
+
+  std::string fileName(const std::string& name) const {
+    return prefix_ + "_" + name + ".csv";
+  }
+
+  std::string prefix_;
+  int bins_;
+  bool first_;
+};
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef PERFORMANCEBASELINE_H
+#define PERFORMANCEBASELINE_H
+
+#include <dune/common/exceptions.hh>
+#include <dune/grid/common/gridenums.hh>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+// Totals of the metrics of a run, e.g. phase times and partition quality summed over the steps, written to and
+// compared with a baseline file of lines "<metric> <value>".  Metrics whose names start with "time." are
+// compared with the time tolerance, all others with the quality tolerance; a metric regresses if it exceeds
+// its baseline by more than the relative tolerance (plus an absolute slack for values near zero).  Only
+// increases count, every metric is one where less is better.
+class PerformanceBaseline {
+public:
+  // Adds value to the total of metric
+  void add(const std::string& metric, double value) {
+    if (totals_.find(metric) == totals_.end())
+      names_.push_back(metric);
+
+    totals_[metric] += value;
+  }
+
+  // Sets metric to the larger of its total and value
+  void max(const std::string& metric, double value) {
+    if (totals_.find(metric) == totals_.end()) {
+      names_.push_back(metric);
+      totals_[metric] = value;
+    }
+    else
+      totals_[metric] = std::max(totals_[metric], value);
+  }
+
+  void write(const std::string& fileName) const {
+    std::ofstream out(fileName.c_str());
+    if (!out)
+      DUNE_THROW(Dune::IOError, "Could not open " << fileName << " for writing.");
+
+    out.precision(12);
+    for (size_t i = 0; i < names_.size(); ++i)
+      out << names_[i] << " " << totals_.find(names_[i])->second << "\n";
+  }
+
+  // Collective: number of faces between interior elements of different ranks
+  template<class GridView>
+  static double edgecut(const GridView& gv) {
+    typedef typename GridView::template Codim<0>::template Partition<Dune::Interior_Partition>::Iterator InteriorElementIterator;
+    typedef typename GridView::IntersectionIterator                                                      IntersectionIterator;
+
+    double faces = 0;
+    for (InteriorElementIterator eIt = gv.template begin<0, Dune::Interior_Partition>(); eIt != gv.template end<0, Dune::Interior_Partition>(); ++eIt)
+      for (IntersectionIterator iIt = gv.ibegin(*eIt); iIt != gv.iend(*eIt); ++iIt)
+	if (iIt->neighbor() && iIt->outside()->partitionType() != Dune::InteriorEntity)
+	  ++faces;
+
+    // Every cut face is seen from both sides
+    return gv.comm().sum(faces) / 2;
+  }
+
+  static PerformanceBaseline read(const std::string& fileName) {
+    std::ifstream in(fileName.c_str());
+    if (!in)
+      DUNE_THROW(Dune::IOError, "Could not open the baseline " << fileName << ".");
+
+    PerformanceBaseline baseline;
+    std::string metric;
+    double value;
+
+    while (in >> metric >> value)
+      baseline.add(metric, value);
+
+    return baseline;
+  }
+
+  // Prints every metric next to its baseline and returns the number of regressions.  Metrics that are
+  // missing in either run are reported but do not fail.
+  int compare(const PerformanceBaseline& baseline, double timeTolerance, double qualityTolerance,
+	      std::ostream& out = std::cout) const {
+    int regressions = 0;
+
+    for (size_t i = 0; i < names_.size(); ++i) {
+      const std::string& metric = names_[i];
+      const double value = totals_.find(metric)->second;
+
+      const std::map<std::string, double>::const_iterator it = baseline.totals_.find(metric);
+      if (it == baseline.totals_.end()) {
+	out << "   " << metric << " " << value << " (no baseline)" << std::endl;
+	continue;
+      }
+
+      const bool time = (metric.compare(0, 5, "time.") == 0);
+      const double tolerance = time ? timeTolerance : qualityTolerance;
+      const double slack = time ? 1e-3 : 1;
+
+      const bool regressed = value > it->second * (1 + tolerance) + slack;
+      if (regressed)
+	++regressions;
+
+      out << "   " << metric << " " << value << " baseline " << it->second << (regressed ? "  REGRESSION" : "") << std::endl;
+    }
+
+    for (size_t i = 0; i < baseline.names_.size(); ++i)
+      if (totals_.find(baseline.names_[i]) == totals_.end())
+	out << "   " << baseline.names_[i] << " missing in this run" << std::endl;
+
+    return regressions;
+  }
+
+private:
+  std::vector<std::string> names_;        // in the order they were first added
+  std::map<std::string, double> totals_;
+};
+
+#endif
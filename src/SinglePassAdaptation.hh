@@ -0,0 +1,125 @@
+#ifndef SINGLEPASSADAPTATION_H
+#define SINGLEPASSADAPTATION_H
+
+#include <set>
+#include <vector>
+
+#include <dune/ug_hpc/Ball.hh>
+
+
+// Adapts the grid to a new ball position in as few adapt() rounds as possible.  The target grid is the one
+// the driver gets by coarsening everything to the macro level and then refining `levels` times the leaves within
+// epsilon of the ball: an element is refined iff it is on a level below `levels`, its center is within epsilon
+// of the ball and its father is refined.  Every leaf is compared with this target once, coarsened if its father
+// should not be refined and refined if it should be refined itself, so refinement and coarsening happen in the
+// same rounds and a step takes at most `levels` of them instead of 2*levels.  Later rounds only visit the
+// children of refined elements and the fathers of coarsened ones, all other leaves have reached their target.
+//
+// UG can only refine or coarsen by one level per adapt(), so the number of rounds is the largest difference
+// between the current and the target level of any leaf.
+template<class Grid>
+class SinglePassAdaptation {
+public:
+  typedef typename Grid::LeafGridView GridView;
+
+  typedef typename GridView::template Codim<0>::template Partition<Dune::Interior_Partition>::Iterator InteriorElementIterator;
+  typedef typename GridView::template Codim<0>::Entity                                                 Element;
+  typedef typename GridView::template Codim<0>::EntityPointer                                          ElementPointer;
+  typedef typename GridView::template Codim<0>::EntitySeed                                             ElementSeed;
+  typedef typename Element::HierarchicIterator                                                         HierarchicIterator;
+
+  typedef typename Grid::GlobalIdSet::IdType IdType;
+
+  enum {
+    dimension = Grid::dimension
+  };
+
+  SinglePassAdaptation(Grid& grid, double epsilon, int levels) : grid_(grid), epsilon_(epsilon), levels_(levels) {}
+
+  // Collective: adapts the grid to ball and returns the number of adapt() rounds
+  int adapt(const Ball<dimension>& ball) {
+    const GridView gv = grid_.leafGridView();
+
+    // Elements whose children or whose own leaf have to be compared with the target after the next round.
+    // Seeds of fathers stay valid across adapt(), only children are created or removed.
+    std::vector<ElementSeed> pending;
+    std::set<IdType> queued;
+
+    bool marked = false;
+    for (InteriorElementIterator eIt = gv.template begin<0, Dune::Interior_Partition>(); eIt != gv.template end<0, Dune::Interior_Partition>(); ++eIt)
+      marked |= markElement(*eIt, ball, pending, queued);
+
+    // Every round changes each leaf by one level, so 2*levels bounds the rounds even if UG refuses some marks
+    int rounds = 0;
+    while (gv.comm().max(int(marked)) && rounds < 2*levels_) {
+      grid_.adapt();
+      grid_.postAdapt();
+      ++rounds;
+
+      std::vector<ElementSeed> candidates;
+      candidates.swap(pending);
+      queued.clear();
+      marked = false;
+
+      for (size_t i = 0; i < candidates.size(); ++i) {
+	const ElementPointer father = grid_.entityPointer(candidates[i]);
+
+	// Coarsened back to a leaf, or refined into new leaves
+	if (father->isLeaf())
+	  marked |= markElement(*father, ball, pending, queued);
+	else {
+	  const int childLevel = father->level() + 1;
+
+	  for (HierarchicIterator hIt = father->hbegin(childLevel); hIt != father->hend(childLevel); ++hIt)
+	    if (hIt->level() == childLevel && hIt->isLeaf())
+	      marked |= markElement(*hIt, ball, pending, queued);
+	}
+      }
+    }
+
+    return rounds;
+  }
+
+private:
+  // Marks a leaf towards its target level and queues the element to look at after the next round
+  bool markElement(const Element& element, const Ball<dimension>& ball, std::vector<ElementSeed>& pending, std::set<IdType>& queued) {
+    int mark = 0;
+
+    if (element.level() > 0 && !refined(*element.father(), ball))
+      mark = -1;
+    else if (refined(element, ball))
+      mark = 1;
+
+    if (0 == mark)
+      return false;
+
+    grid_.mark(mark, element);
+
+    // Refined elements get new children, coarsened ones make their father a leaf
+    if (mark > 0)
+      queue(element, pending, queued);
+    else
+      queue(*element.father(), pending, queued);
+
+    return true;
+  }
+
+  void queue(const Element& element, std::vector<ElementSeed>& pending, std::set<IdType>& queued) const {
+    if (queued.insert(grid_.globalIdSet().id(element)).second)
+      pending.push_back(element.seed());
+  }
+
+  // True if element is refined in the target grid
+  bool refined(const Element& element, const Ball<dimension>& ball) const {
+    if (element.level() >= levels_ || !(ball.distanceTo(element.geometry().center()) < epsilon_))
+      return false;
+
+    return element.level() == 0 || refined(*element.father(), ball);
+  }
+
+  Grid& grid_;
+  double epsilon_;
+  int levels_;
+};
+
+#endif
@@ -1,6 +1,7 @@
 #ifdef HAVE_CONFIG_H
 # include "config.h"     
 #endif
+#include <cstdlib>
 #include <iostream>
 
 #include <dune/grid/io/file/vtk/vtkwriter.hh>
@@ -13,8 +14,28 @@
 #include <dune/common/parametertree.hh>
 #include <dune/common/parametertreeparser.hh>
 
-#include "Ball.hh"
-#include "Parmetisgridpartitioner.hh"
+#include <dune/ug_hpc/AsyncRepartitioner.hh>
+#include <dune/ug_hpc/Ball.hh>
+#include <dune/ug_hpc/DiffusionBenchmark.hh>
+#include <dune/ug_hpc/DiffusiveLoadBalancer.hh>
+#include <dune/ug_hpc/ElasticPartCount.hh>
+#include <dune/ug_hpc/GraphPartitioner.hh>
+#include <dune/ug_hpc/GraphTrace.hh>
+#include <dune/ug_hpc/HaloExchange.hh>
+#include <dune/ug_hpc/ItrController.hh>
+#include <dune/ug_hpc/MacroMeshReader.hh>
+#include <dune/ug_hpc/MemoryUsage.hh>
+#include <dune/ug_hpc/Parmetisgridpartitioner.hh>
+#include <dune/ug_hpc/PartitionCache.hh>
+#include <dune/ug_hpc/PartitionRemapping.hh>
+#include <dune/ug_hpc/RefinementIndicator.hh>
+#include <dune/ug_hpc/RefinementPredictor.hh>
+#include <dune/ug_hpc/SpaceFillingCurveOrdering.hh>
+
+#include "EventTrace.hh"
+#include "InSituOutput.hh"
+#include "PerformanceBaseline.hh"
+#include "SinglePassAdaptation.hh"
 
 using namespace Dune;
 
@@ -36,8 +57,35 @@ typedef GridType::LeafGridView GV;
 typedef GV::Codim<0>::Partition<Interior_Partition>::Iterator ElementIterator;
 
 
+// Finalizes MPI if it was initialized by main rather than by MPIHelper
+void finalizeMPI() {
+  int finalized;
+  MPI_Finalized(&finalized);
+
+  if (!finalized)
+    MPI_Finalize();
+}
+
+
 int main(int argc, char** argv) try
 {
+  // Parse parameter file
+  const std::string parameterFileName = "param.ini";
+
+  ParameterTree parameterSet;
+  ParameterTreeParser::readINITree(parameterFileName, parameterSet);
+  ParameterTreeParser::readOptions(argc, argv, parameterSet);
+
+  // The asynchronous repartitioner calls ParMETIS from a helper thread while the main thread keeps
+  // communicating, so MPI has to be initialized with full thread support before MPIHelper does it
+  const bool asyncRepartition = parameterSet.get<bool>("partition.async", false);
+
+  if (asyncRepartition) {
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+    std::atexit(finalizeMPI);
+  }
+
   // Create MPIHelper instance
   MPIHelper& mpihelper = MPIHelper::instance(argc, argv);
 
@@ -45,20 +93,48 @@ int main(int argc, char** argv) try
     std::cout << "Using " << mpihelper.size() << " Processes." << std::endl;
   }
 
-  // Parse parameter file
-  const std::string parameterFileName = "param.ini";
+  // Timeline of the loop phases and, through the wrappers in EventTraceMPI.cc, of the MPI waits on every rank
+  const bool timelineEnabled = parameterSet.get<bool>("timeline.enable", false);
+  EventTrace timeline(timelineEnabled, parameterSet.get<size_t>("timeline.capacity", 1 << 16));
 
-  ParameterTree parameterSet;
-  ParameterTreeParser::readINITree(parameterFileName, parameterSet);
+  // Without a timeline, the wrapped MPI calls skip the timing entirely
+  if (timelineEnabled && parameterSet.get<bool>("timeline.mpi", true))
+    EventTrace::global() = &timeline;
 
-  // Create ug grid from structured grid
-  const std::array<unsigned, dim> n = parameterSet.get<std::array<unsigned, dim> >("n");
+  timeline.begin("createGrid");
 
-  const GlobalVector
-    lower = parameterSet.get<GlobalVector>("lower"),
-    upper = parameterSet.get<GlobalVector>("upper");
+  // Memory instrumentation
+  const bool reportMemory = parameterSet.get<bool>("memory.report", false);
+  const bool balanceMemory = parameterSet.get<bool>("memory.balance", false);
 
-  shared_ptr<GridType> grid = StructuredGridFactory<GridType>::createSimplexGrid(lower, upper, n);
+  MemoryStatistics memoryStatistics(parameterSet.get<double>("memory.warnFraction", 0.1));
+  MemoryStatistics* memoryStatisticsPtr = reportMemory ? &memoryStatistics : NULL;
+
+  // Give every rank at least this many elements and leave the others idle while the grid is small
+  const ElasticPartCount partCount(parameterSet.get<long>("partition.minElementsPerRank", 0));
+
+  // Create ug grid from structured grid, or read a binary macro mesh in parallel, which also partitions it
+  const std::string meshFile = parameterSet.get<std::string>("grid.file", "");
+
+  shared_ptr<GridType> grid;
+  std::vector<unsigned> part;
+
+  if (meshFile.empty()) {
+    const std::array<unsigned, dim> n = parameterSet.get<std::array<unsigned, dim> >("n");
+
+    const GlobalVector
+      lower = parameterSet.get<GlobalVector>("lower"),
+      upper = parameterSet.get<GlobalVector>("upper");
+
+    grid = StructuredGridFactory<GridType>::createSimplexGrid(lower, upper, n);
+  }
+  else
+    grid = MacroMeshReader<GridType>::read(meshFile, part, partCount);
+
+  timeline.end();
+
+  if (reportMemory)
+    memoryStatistics.sample("createGrid");
 
   const GV gv = grid->leafGridView();
 
@@ -75,12 +151,198 @@ int main(int argc, char** argv) try
   const double epsilon = parameterSet.get<double>("epsilon");
   const int levels = parameterSet.get<int>("levels");
 
+  // The ball follows the waypoints if there are any, and moves by stepDisplacement afterwards
+  Trajectory<dim> trajectory(center, stepDisplacement);
+
+  const std::vector<double> waypointCoordinates = parameterSet.get<std::vector<double> >("waypoints", std::vector<double>());
+  std::vector<GlobalVector> waypoints(waypointCoordinates.size() / dim);
+  for (size_t i = 0; i < waypoints.size(); ++i)
+    for (int j = 0; j < dim; ++j)
+      waypoints[i][j] = waypointCoordinates[dim*i + j];
+
+  trajectory.setWaypoints(waypoints);
+
+  RefinementPredictor<dim> predictor(trajectory, r, epsilon, levels);
+
+  // Adapt directly from the previous step's grid to the next one instead of coarsening to the macro level and
+  // refining level by level
+  const bool singlePass = parameterSet.get<bool>("refinement.singlePass", false);
+
+  SinglePassAdaptation<GridType> adaptation(*grid, epsilon, levels);
+
+  // Refine within epsilon of the ball surface.  Coarsening either coarsens everything to the macro grid or only
+  // the elements farther than coarsenFactor * epsilon from the moved ball, which the refinement keeps otherwise.
+  const BallIndicator<dim> indicator(ball, epsilon, parameterSet.get<double>("refinement.coarsenFactor", 1.));
+
+  const std::string coarsening = parameterSet.get<std::string>("refinement.coarsen", "all");
+  if (coarsening != "all" && coarsening != "indicator")
+    DUNE_THROW(Exception, "Unknown refinement.coarsen " << coarsening << ", use all or indicator.");
+
+  // Balance constraints for repartitioning
+  typedef PartitionConstraints<GV> Constraints;
+
+  Constraints constraints;
+
+  const std::vector<std::string> constraintNames = parameterSet.get<std::vector<std::string> >("partition.constraints", std::vector<std::string>());
+  const std::vector<real_t> tolerances = parameterSet.get<std::vector<real_t> >("partition.tolerances", std::vector<real_t>());
+
+  for (size_t i = 0; i < constraintNames.size(); ++i)
+    constraints.add(Constraints::kind(constraintNames[i]), i < tolerances.size() ? tolerances[i] : 1.05);
+
+  if (balanceMemory) {
+    if (constraintNames.empty())
+      constraints.add(Constraints::Elements);
+
+    constraints.add(Constraints::Memory);
+  }
+
+  // The predicted constraint, from partition.predictive or listed in partition.constraints, balances the load
+  // predicted for the next step instead of the current element count
+  if (parameterSet.get<bool>("partition.predictive", false))
+    constraints.add(Constraints::Predicted, parameterSet.get<real_t>("partition.predictiveTolerance", 1.05));
+
+  constraints.setPredictor(&predictor);
+
+  const std::vector<real_t> targetFractions = parameterSet.get<std::vector<real_t> >("partition.targetFractions", std::vector<real_t>());
+  constraints.setTargetFractions(targetFractions);
+
+  // Partition across compute nodes first and across the ranks of each node second
+  const bool hierarchical = parameterSet.get<bool>("partition.hierarchical", false);
+
+  shared_ptr<NodeTopology> topology;
+  if (hierarchical)
+    topology = shared_ptr<NodeTopology>(new NodeTopology(MPIHelper::getCommunicator()));
+
+  // Partition the macro elements, which are what loadBalance(part, 0) actually moves
+  const bool coarse = parameterSet.get<bool>("partition.coarse", false);
+  if (coarse && hierarchical)
+    DUNE_THROW(Exception, "partition.coarse and partition.hierarchical cannot be combined.");
+
+  // Serial METIS on rank 0 instead of ParMETIS for the flat repartition: always (metis), never (parmetis), or
+  // automatically for small graphs and for few ranks on a single node (auto); or PT-Scotch or Zoltan instead
+  const std::string backendName = parameterSet.get<std::string>("partition.backend", "parmetis");
+  const bool graphBackend = (backendName == "scotch" || backendName == "zoltan");
+  if (backendName != "parmetis" && backendName != "metis" && backendName != "auto" && !graphBackend)
+    DUNE_THROW(Exception, "Unknown partitioner backend " << backendName << ".");
+
+  const GraphPartitioner::Method graphMethod = graphBackend ? GraphPartitioner::method(backendName) : GraphPartitioner::AdaptiveRepart;
+
+  // PT-Scotch and Zoltan have no target weights per part, and Scotch balances the first constraint only
+  if (graphBackend && !targetFractions.empty())
+    DUNE_THROW(Exception, "partition.targetFractions does not work with partition.backend " << backendName << ".");
+  if (backendName == "scotch" && constraints.ncon() > 1)
+    DUNE_THROW(Exception, "partition.backend scotch balances a single constraint, got " << constraints.ncon() << ".");
+
+  const long serialVertices = parameterSet.get<long>("partition.serialVertices", 20000);
+
+  bool alwaysSerial = (backendName == "metis");
+  if (backendName == "auto" && mpihelper.size() <= parameterSet.get<int>("partition.serialMaxRanks", 8))
+    alwaysSerial = (1 == NodeTopology(MPIHelper::getCommunicator()).numNodes());
+
+  // The elastic part count is applied by the initial partition, the mesh reader and the flat leaf repartitions
+  if (partCount.enabled() && (hierarchical || coarse || asyncRepartition || !targetFractions.empty()))
+    DUNE_THROW(Exception, "partition.minElementsPerRank only works with the flat leaf repartitions, not with hierarchical, coarse, async or targetFractions.");
+
+  // Relabel the parts of global repartitions so that most elements stay where they are
+  const PartitionRemapping<GV>::Method remapMethod = PartitionRemapping<GV>::method(parameterSet.get<std::string>("partition.remap", "none"));
+
+  shared_ptr<AsyncRepartitioner<GV> > asyncRepartitioner;
+  if (asyncRepartition) {
+    if (AsyncRepartitioner<GV>::supported())
+      asyncRepartitioner = shared_ptr<AsyncRepartitioner<GV> >(new AsyncRepartitioner<GV>(constraints));
+    else if (0 == mpihelper.rank())
+      std::cout << "MPI lacks MPI_THREAD_MULTIPLE, repartitioning synchronously." << std::endl;
+  }
+
+  // Use neighbor-only diffusion instead of a global repartition while the imbalance stays below this ratio
+  const double diffusiveThreshold = parameterSet.get<double>("partition.diffusiveThreshold", 0);
+  const int diffusionIterations = parameterSet.get<int>("partition.diffusionIterations", 20);
+
+  // Totals of phase times and partition quality, written as baseline and/or compared with one
+  const std::string perfRecord = parameterSet.get<std::string>("perf.record", "");
+  const std::string perfBaseline = parameterSet.get<std::string>("perf.baseline", "");
+  const bool perf = !perfRecord.empty() || !perfBaseline.empty();
+
+  PerformanceBaseline performance;
+
+  // Rank 0 reads the baseline before the run and compares with it at the end; a missing baseline fails on all
+  // ranks at once instead of leaving the others waiting for the result
+  PerformanceBaseline baseline;
+  if (!perfBaseline.empty()) {
+    int found = 1;
+    if (0 == mpihelper.rank()) {
+      try {
+	baseline = PerformanceBaseline::read(perfBaseline);
+      }
+      catch (IOError&) {
+	found = 0;
+      }
+    }
+
+    grid->comm().broadcast(&found, 1, 0);
+    if (!found)
+      DUNE_THROW(IOError, "Could not open the baseline " << perfBaseline << ".");
+  }
+
+  // Reuse the partitions of recurring grid states instead of repartitioning
+  const size_t cacheCapacity = parameterSet.get<size_t>("partition.cache", 0);
+  PartitionCache<GV> partitionCache(cacheCapacity, parameterSet.get<double>("partition.cacheResolution", 1e-9));
+
+  // Diffusion steps with halo exchange after every loadBalance, to measure how well the partition computes
+  const int benchmarkIterations = parameterSet.get<int>("benchmark.iterations", 0);
+  const bool benchmarkPerRank = parameterSet.get<bool>("benchmark.perRank", false);
+  const HaloExchange<GV>::Method benchmarkExchange = HaloExchange<GV>::method(parameterSet.get<std::string>("benchmark.exchange", "communicate"));
+
+  // Derive ParMETIS' itr from the measured halo exchange and migration costs instead of using partition.itr throughout
+  const bool autoItr = parameterSet.get<bool>("partition.autoItr", false);
+  const int itrProbes = parameterSet.get<int>("partition.itrProbes", 5);
+
+  ItrController<GV> itrController(parameterSet.get<real_t>("partition.itr", 1000),
+				  parameterSet.get<double>("partition.itrIterationsPerStep", 100),
+				  parameterSet.get<double>("partition.itrSmoothing", 0.5));
 
-  // Create initial partitioning using ParMETIS
-  std::vector<unsigned> part(ParMetisGridPartitioner<GV>::initialPartition(gv, mpihelper));
+  // Full VTK output of the leaf grid and/or reduced in-situ output of the refinement front and statistics
+  const std::string outputMode = parameterSet.get<std::string>("output.mode", "vtk");
+  const bool vtkOutput = (outputMode == "vtk" || outputMode == "both");
+  const bool inSituOutput = (outputMode == "insitu" || outputMode == "both");
+
+  if (!vtkOutput && !inSituOutput && outputMode != "none")
+    DUNE_THROW(Exception, "Unknown output mode " << outputMode << ".");
+
+  const std::string frontName = parameterSet.get<std::string>("output.front", "ball");
+  if (frontName != "ball" && frontName != "refined")
+    DUNE_THROW(Exception, "Unknown front " << frontName << ".");
+
+  InSituOutput<GV> inSitu(parameterSet.get<std::string>("output.prefix", "insitu"), parameterSet.get<int>("output.qualityBins", 10));
+  const BallFront<dim> ballFront(ball, parameterSet.get<double>("output.frontDistance", epsilon));
+
+  // Dump the dual graph of every step before repartitioning, for replay_partitioner
+  const bool recordTrace = parameterSet.get<bool>("trace.record", false);
+  const std::string tracePrefix = parameterSet.get<std::string>("trace.prefix", "graph");
+
+
+  // Create initial partitioning using ParMETIS, the mesh reader has done so already
+  if (meshFile.empty()) {
+    timeline.begin("initialPartition");
+    part = ParMetisGridPartitioner<GV>::initialPartition(gv, mpihelper, partCount);
+    timeline.end();
+  }
 
   // Transfer partitioning from ParMETIS to our grid
+  timeline.begin("loadBalance");
   grid->loadBalance(part, 0);
+  timeline.end();
+
+  // Lay out per-element data along a space-filling curve; renumbered whenever the leaf grid changes
+  shared_ptr<SpaceFillingCurveOrdering<GV> > ordering;
+  if (parameterSet.get<bool>("ordering.spaceFillingCurve", false))
+    ordering = shared_ptr<SpaceFillingCurveOrdering<GV> >(new SpaceFillingCurveOrdering<GV>(gv));
+
+  if (reportMemory) {
+    memoryStatistics.sample("initialBalance");
+    memoryStatistics.report(grid->comm());
+    memoryStatistics.clear();
+  }
 
   /*
   std::vector<unsigned> part;
@@ -90,52 +352,218 @@ int main(int argc, char** argv) try
   for (size_t s = 0; s < steps; ++s) {
     std::cout << "Step " << s << " on " << mpihelper.rank() << " ..." << std::endl;
 
-    for (int k = 0; k < levels; ++k) {
-      std::cout << "   Refining level " << k << " on " << mpihelper.rank() << " ..." << std::endl;
+    ScopedEvent stepEvent(timeline, "step");
+
+    timeline.begin("refine");
+    const double refineStart = MPI_Wtime();
+    if (singlePass) {
+      const int rounds = adaptation.adapt(ball);
+
+      if (0 == mpihelper.rank())
+	std::cout << "   Adapted in " << rounds << " rounds" << std::endl;
+    }
+    else {
+      for (int k = 0; k < levels; ++k) {
+	std::cout << "   Refining level " << k << " on " << mpihelper.rank() << " ..." << std::endl;
+
+	// select elements that are close to the sphere for grid refinement
+	IndicatorMarking<GridType>::mark(*grid, indicator, levels, true, false);
 
-      // select elements that are close to the sphere for grid refinement
-      for (ElementIterator eIt = gv.begin<0, Interior_Partition>(); eIt != gv.end<0, Interior_Partition>(); ++eIt) {
-	if (ball.distanceTo(eIt->geometry().center()) < epsilon)
-	  grid->mark(1, *eIt);
+	// adapt grid
+	grid->adapt();
+
+	// clean up markers
+	grid->postAdapt();
       }
+    }
 
-      // adapt grid
-      grid->adapt();
+    const double refineTime = MPI_Wtime() - refineStart;
+    timeline.end();
 
-      // clean up markers
-      grid->postAdapt();
+    if (reportMemory)
+      memoryStatistics.sample("refine");
+
+    if (ordering) {
+      timeline.begin("ordering");
+      ordering->update();
+      timeline.end();
     }
 
+    timeline.begin("synchronize");
 mpihelper.getCollectiveCommunication().barrier();
+    timeline.end();
 
     // Repartition
-    real_t itr = 1000; // ratio of inter-processor communication time compared to data redistribution time
+    predictor.setStep(s);
+
+    if (recordTrace)
+      GraphTrace::capture(gv, s, constraints).write(tracePrefix);
+
+    timeline.begin("repartition");
+    const double repartitionStart = MPI_Wtime();
+
+    real_t itr = itrController.itr(); // ratio of inter-processor communication time compared to data redistribution time
                        // high ~> minimize edge-cut and have smaller communication time during calculations
                        // low  ~> do not move elements around between processes too much and thous reduce communication time during redistribution
 
-    part = ParMetisGridPartitioner<GV>::repartition(gv, mpihelper, itr);
+    // Diffusion already targets neighboring ranks, and the hierarchical labels are tied to the nodes,
+    // so only the labels of the flat global repartitions are free to be remapped
+    bool remappable = false;
+
+    bool cached = false;
+    PartitionCache<GV>::Fingerprint fingerprint;
+    if (cacheCapacity > 0)
+      fingerprint = partitionCache.fingerprint(gv);
+
+    if (asyncRepartitioner && asyncRepartitioner->pending())
+      part = asyncRepartitioner->finish(gv); // computed in the background since the last step
+    else if (cacheCapacity > 0 && partitionCache.lookup(gv, fingerprint, part))
+      cached = true;
+    else if (diffusiveThreshold > 0 && DiffusiveLoadBalancer<GV>::imbalance(gv, constraints) <= diffusiveThreshold)
+      part = DiffusiveLoadBalancer<GV>::repartition(gv, constraints, diffusionIterations);
+    else if (hierarchical)
+      part = ParMetisGridPartitioner<GV>::hierarchicalRepartition(gv, mpihelper, *topology, itr, constraints, memoryStatisticsPtr);
+    else {
+      if (coarse)
+	part = ParMetisGridPartitioner<GV>::coarseRepartition(gv, mpihelper, itr, constraints, memoryStatisticsPtr);
+      else if (graphBackend)
+	part = ParMetisGridPartitioner<GV>::graphRepartition(gv, mpihelper, graphMethod, itr, constraints, memoryStatisticsPtr, ordering.get(), partCount);
+      else if (alwaysSerial || (backendName == "auto" && ParMetisGridPartitioner<GV>::smallGraph(gv, serialVertices)))
+	part = ParMetisGridPartitioner<GV>::serialRepartition(gv, mpihelper, constraints, memoryStatisticsPtr, ordering.get(), partCount);
+      else if (partCount.enabled())
+	part = ParMetisGridPartitioner<GV>::graphRepartition(gv, mpihelper, GraphPartitioner::AdaptiveRepart, itr, constraints, memoryStatisticsPtr, ordering.get(), partCount);
+      else
+	part = ParMetisGridPartitioner<GV>::repartition(gv, mpihelper, itr, constraints, memoryStatisticsPtr, ordering.get());
+
+      remappable = true;
+    }
+
+    const double repartitionTime = MPI_Wtime() - repartitionStart;
+    timeline.end();
+
+    if (remappable && remapMethod != PartitionRemapping<GV>::None) {
+      ScopedEvent remapEvent(timeline, "remap");
+      const double retained = PartitionRemapping<GV>::remap(gv, part, mpihelper.size(), remapMethod, constraints);
+
+      if (0 == mpihelper.rank())
+	std::cout << "   Remapping keeps " << 100*retained << "% of the load in place" << std::endl;
+    }
+
+    if (cacheCapacity > 0) {
+      if (!cached)
+	partitionCache.store(gv, fingerprint, part);
+
+      if (0 == mpihelper.rank())
+	std::cout << "   Partition cache " << (cached ? "hit" : "miss") << " (" << partitionCache.hits() << " hits, "
+		  << partitionCache.misses() << " misses)" << std::endl;
+    }
+
+    if (reportMemory)
+      memoryStatistics.sample("repartition");
+
+    const double migrated = (autoItr || perf) ? ItrController<GV>::migratedElements(gv, part) : 0;
 
     // Transfer partitioning from ParMETIS to our grid
+    timeline.begin("loadBalance");
+    const double loadBalanceStart = MPI_Wtime();
     grid->loadBalance(part, 0);
+    const double loadBalanceTime = MPI_Wtime() - loadBalanceStart;
+    timeline.end();
+
+    if (ordering) {
+      timeline.begin("ordering");
+      ordering->update();
+      timeline.end();
+    }
+
+    if (reportMemory)
+      memoryStatistics.sample("loadBalance");
+
+    if (perf) {
+      performance.add("time.refine", grid->comm().max(refineTime));
+      performance.add("time.repartition", grid->comm().max(repartitionTime));
+      performance.add("time.loadBalance", grid->comm().max(loadBalanceTime));
+      performance.add("migratedMaxRank", migrated);
+      performance.add("edgecut", PerformanceBaseline::edgecut(gv));
+      performance.max("imbalance", DiffusiveLoadBalancer<GV>::imbalance(gv, constraints));
+    }
+
+    if (benchmarkIterations > 0) {
+      ScopedEvent benchmarkEvent(timeline, "benchmark");
+
+      DiffusionBenchmark<GV> benchmark(gv, ordering.get(), benchmarkExchange);
+      const DiffusionBenchmark<GV>::Timings timings = benchmark.run(benchmarkIterations);
+
+      DiffusionBenchmark<GV>::report(grid->comm(), timings, benchmarkPerRank);
+
+      const double checksum = benchmark.checksum();
+      if (0 == mpihelper.rank())
+	std::cout << "   checksum         " << checksum << std::endl;
+
+      if (autoItr)
+	itrController.observeCommunication(gv, timings.communicationPerIteration());
+    }
+    else if (autoItr)
+      itrController.probeCommunication(gv, itrProbes);
+
+    if (autoItr) {
+      itrController.observeMigration(gv, migrated, loadBalanceTime);
+      itrController.update();
+
+      if (0 == mpihelper.rank())
+	std::cout << "   itr " << itrController.itr() << " (" << itrController.edgeCost() << " s per cut face and exchange, "
+		  << itrController.moveCost() << " s per migrated element)" << std::endl;
+    }
+
+    // Partition the balanced grid in the background while the grid is written, coarsened and refined
+    if (asyncRepartitioner && s+1 < steps) {
+      ScopedEvent startEvent(timeline, "startAsyncRepartition");
+      asyncRepartitioner->setItr(itrController.itr());
+      asyncRepartitioner->start(gv);
+    }
 
     // Output grid
-    const std::string baseOutName = "RefinedGrid_";
+    timeline.begin("output");
+    if (vtkOutput) {
+      const std::string baseOutName = "RefinedGrid_";
+
+      VTKWriter<GV> vtkWriter(gv);
+      std::vector<int> rankField(gv.size(0));
+      std::fill(rankField.begin(), rankField.end(), grid->comm().rank());
+      vtkWriter.addCellData(rankField,"rank");
+      vtkWriter.write(baseOutName+toString(s));
+    }
+
+    if (inSituOutput) {
+      if (frontName == "ball")
+	inSitu.write(gv, s, ballFront);
+      else
+	inSitu.write(gv, s, RefinedFront());
+    }
+    timeline.end();
 
-    VTKWriter<GV> vtkWriter(gv);
-    std::vector<int> rankField(gv.size(0));
-    std::fill(rankField.begin(), rankField.end(), grid->comm().rank());
-    vtkWriter.addCellData(rankField,"rank");
-    vtkWriter.write(baseOutName+toString(s));
+    if (reportMemory) {
+      memoryStatistics.sample("output");
+      memoryStatistics.report(grid->comm());
+      memoryStatistics.clear();
+    }
 
     // If this is not the last step, move sphere and coarsen grid
     if (s+1 < steps) {
       // Move sphere a little
-      ball.center += stepDisplacement;
+      ball.center = trajectory.center(s+1);
 
-      // Coarsen everything
+      // The single pass adaptation coarsens as part of the next step's refinement
+      if (singlePass)
+	continue;
+
+      ScopedEvent coarsenEvent(timeline, "coarsen");
       for (int k = 0; k < levels; ++k) {
-	for (ElementIterator eIt = gv.begin<0, Interior_Partition>(); eIt != gv.end<0, Interior_Partition>(); ++eIt)
-	  grid->mark(-1, *eIt);
+	if (coarsening == "indicator")
+	  IndicatorMarking<GridType>::mark(*grid, indicator, levels, false, true);
+	else
+	  for (ElementIterator eIt = gv.begin<0, Interior_Partition>(); eIt != gv.end<0, Interior_Partition>(); ++eIt)
+	    grid->mark(-1, *eIt);
 
 	// adapt grid
 	grid->adapt();
@@ -143,12 +571,41 @@ mpihelper.getCollectiveCommunication().barrier();
 	// clean up markers
 	grid->postAdapt();
       }
+
+      if (reportMemory)
+	memoryStatistics.sample("coarsen");
     }
   }
 
+  EventTrace::global() = NULL;
+  timeline.write(parameterSet.get<std::string>("timeline.file", "timeline.json"));
+
+  if (!perfRecord.empty() && 0 == mpihelper.rank())
+    performance.write(perfRecord);
+
+  // Fail on regressions against the baseline
+  if (!perfBaseline.empty()) {
+    int regressions = 0;
+
+    if (0 == mpihelper.rank()) {
+      std::cout << "Performance against " << perfBaseline << ":" << std::endl;
+      regressions = performance.compare(baseline,
+					parameterSet.get<double>("perf.timeTolerance", 0.5),
+					parameterSet.get<double>("perf.qualityTolerance", 0.1));
+    }
+
+    grid->comm().broadcast(&regressions, 1, 0);
+
+    if (regressions > 0) {
+      if (0 == mpihelper.rank())
+	std::cerr << regressions << " metrics regressed." << std::endl;
+      return 1;
+    }
+  }
 
   return 0;
 }
 catch (Exception &e){
   std::cerr << "Exception: " << e << std::endl;
+  return 1;
 }
@@ -0,0 +1,145 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dune/common/exceptions.hh>
+
+#include <dune/ug_hpc/MacroMeshReader.hh>
+
+using namespace Dune;
+
+
+// Converts a Gmsh mesh (ASCII format 2.x) into the binary macro mesh read by MacroMeshReader:
+//   gmsh2macromesh <input.msh> <output.mesh> [dimension]
+// Keeps the elements of the given dimension (default 2), which all have to be of the same type: triangles,
+// quadrilaterals, tetrahedra or hexahedra.  Nodes are renumbered consecutively in the order of the $Nodes
+// section, cube corners are reordered from the Gmsh to the Dune numbering.
+
+
+// Number of corners and dimension of the Gmsh element types we convert, 0 for all others
+void elementType(int type, int& corners, int& dimension) {
+  switch (type) {
+  case 2:  corners = 3; dimension = 2; break; // triangle
+  case 3:  corners = 4; dimension = 2; break; // quadrilateral
+  case 4:  corners = 4; dimension = 3; break; // tetrahedron
+  case 5:  corners = 8; dimension = 3; break; // hexahedron
+  default: corners = 0; dimension = 0;
+  }
+}
+
+int main(int argc, char** argv) try
+{
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " <input.msh> <output.mesh> [dimension]" << std::endl;
+    return 1;
+  }
+
+  const int dimension = (argc > 3) ? std::atoi(argv[3]) : 2;
+
+  std::ifstream in(argv[1]);
+  if (!in)
+    DUNE_THROW(IOError, "Could not open " << argv[1] << ".");
+
+  // Gmsh node number -> consecutive vertex number
+  std::map<long, int64_t> vertexNumber;
+  std::vector<double> vertices;
+  std::vector<int64_t> elements;
+  int cornersPerElement = 0;
+
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.compare(0, 11, "$MeshFormat") == 0) {
+      double version;
+      int fileType, dataSize;
+      in >> version >> fileType >> dataSize;
+
+      if (version < 2 || version >= 3 || fileType != 0)
+	DUNE_THROW(IOError, argv[1] << " is not an ASCII Gmsh 2.x mesh.");
+    }
+    else if (line.compare(0, 6, "$Nodes") == 0) {
+      long n;
+      in >> n;
+
+      for (long i = 0; i < n; ++i) {
+	long id;
+	double x[3];
+	in >> id >> x[0] >> x[1] >> x[2];
+
+	const int64_t number = vertexNumber.size();
+	vertexNumber[id] = number;
+	for (int j = 0; j < dimension; ++j)
+	  vertices.push_back(x[j]);
+      }
+    }
+    else if (line.compare(0, 9, "$Elements") == 0) {
+      long n;
+      in >> n;
+      std::getline(in, line);
+
+      for (long i = 0; i < n; ++i) {
+	std::getline(in, line);
+	std::istringstream element(line);
+
+	long id;
+	int type, numTags, corners, elementDimension;
+	element >> id >> type >> numTags;
+
+	for (int t = 0; t < numTags; ++t) {
+	  long tag;
+	  element >> tag;
+	}
+
+	// Boundary and lower-dimensional elements are dropped
+	elementType(type, corners, elementDimension);
+	if (elementDimension != dimension)
+	  continue;
+
+	if (cornersPerElement == 0)
+	  cornersPerElement = corners;
+	else if (corners != cornersPerElement)
+	  DUNE_THROW(IOError, argv[1] << " mixes element types, the binary macro mesh supports only one.");
+
+	std::vector<int64_t> nodes(corners);
+	for (int k = 0; k < corners; ++k) {
+	  long node;
+	  element >> node;
+
+	  if (vertexNumber.find(node) == vertexNumber.end())
+	    DUNE_THROW(IOError, "Element " << id << " refers to the unknown node " << node << ".");
+	  nodes[k] = vertexNumber[node];
+	}
+
+	// Gmsh numbers the corners of a cube face counterclockwise, Dune lexicographically
+	if (corners == (1 << dimension)) {
+	  std::swap(nodes[2], nodes[3]);
+	  if (dimension == 3)
+	    std::swap(nodes[6], nodes[7]);
+	}
+
+	elements.insert(elements.end(), nodes.begin(), nodes.end());
+      }
+    }
+  }
+
+  if (0 == cornersPerElement)
+    DUNE_THROW(IOError, argv[1] << " has no elements of dimension " << dimension << ".");
+
+  MacroMeshFormat::write(argv[2], dimension, cornersPerElement, vertices, elements);
+
+  std::cout << argv[2] << ": " << vertices.size() / dimension << " vertices, "
+	    << elements.size() / cornersPerElement << " elements" << std::endl;
+
+  return 0;
+}
+catch (Exception &e){
+  std::cerr << "Exception: " << e << std::endl;
+  return 1;
+}
@@ -0,0 +1,294 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include <dune/grid/uggrid.hh>
+#include <dune/grid/utility/structuredgridfactory.hh>
+
+#include <dune/common/parallel/mpihelper.hh>
+#include <dune/common/exceptions.hh>
+#include <dune/common/parametertree.hh>
+#include <dune/common/parametertreeparser.hh>
+
+#include <mpi.h>
+
+#include <parmetis.h>
+
+#include <dune/ug_hpc/Ball.hh>
+#include <dune/ug_hpc/DynamicLoadBalancer.hh>
+#include <dune/ug_hpc/GlobalUniqueIndex.hh>
+#include <dune/ug_hpc/HaloExchange.hh>
+#include <dune/ug_hpc/Parmetisgridpartitioner.hh>
+#include <dune/ug_hpc/PartitionConstraints.hh>
+#include <dune/ug_hpc/RefinementIndicator.hh>
+
+using namespace Dune;
+
+
+// Times the kernels of the module separately on synthetic grids: a structured simplex grid on the unit square
+// per size in microbenchmark.sizes, of which the fraction microbenchmark.refine of the elements, chosen by a
+// hash of microbenchmark.seed and the element center, is refined once, so the grid is the same on any number
+// of ranks.  Every kernel runs microbenchmark.repetitions times; the time of a repetition is that of the
+// slowest rank.  Rank 0 writes the results as JSON to <microbenchmark.prefix>_np<ranks>.json; compare runs on
+// different rank counts to see the scaling.  Settings are read from the [microbenchmark] section of param.ini
+// and can be overridden on the command line, e.g. -microbenchmark.sizes "64 128".
+
+const int dim = 2;
+
+typedef FieldVector<double, dim> GlobalVector;
+
+typedef UGGrid<dim> GridType;
+typedef GridType::LeafGridView GV;
+
+typedef GV::Codim<0>::Iterator ElementIterator;
+typedef GV::Codim<0>::Partition<Interior_Partition>::Iterator InteriorElementIterator;
+
+#if PARMETIS_MAJOR_VERSION < 4
+typedef idxtype idx_t;
+typedef float real_t;
+#endif
+
+
+// Time of one kernel over the repetitions
+struct Result {
+  std::string kernel;
+  unsigned size;
+  int elements;      // leaf elements over all ranks
+  std::vector<double> times;
+
+  double minTime() const {
+    return *std::min_element(times.begin(), times.end());
+  }
+
+  double maxTime() const {
+    return *std::max_element(times.begin(), times.end());
+  }
+
+  double meanTime() const {
+    double sum = 0;
+    for (size_t i = 0; i < times.size(); ++i)
+      sum += times[i];
+
+    return sum / times.size();
+  }
+};
+
+// Collective: starts a repetition on all ranks at once
+double start(const MPIHelper& mpihelper) {
+  mpihelper.getCollectiveCommunication().barrier();
+  return MPI_Wtime();
+}
+
+// Collective: time since start on the slowest rank
+double stop(const MPIHelper& mpihelper, double startTime) {
+  return mpihelper.getCollectiveCommunication().max(MPI_Wtime() - startTime);
+}
+
+// Uniform number in [0, 1) from the seed and a point, the same on every rank
+double random(uint64_t seed, const GlobalVector& x) {
+  uint64_t h = seed;
+  for (int j = 0; j < dim; ++j) {
+    h ^= static_cast<uint64_t>(x[j] * (1ull << 40)) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+    h ^= h >> 31;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 29;
+  }
+
+  return (h >> 11) * (1. / (1ull << 53));
+}
+
+void writeJSON(const std::string& fileName, int ranks, int seed, double refine, const std::vector<Result>& results) {
+  std::ofstream out(fileName.c_str());
+  if (!out)
+    DUNE_THROW(IOError, "Could not open " << fileName << " for writing.");
+
+  out << "{\n"
+      << "  \"ranks\": " << ranks << ",\n"
+      << "  \"seed\": " << seed << ",\n"
+      << "  \"refine\": " << refine << ",\n"
+      << "  \"results\": [\n";
+
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& r = results[i];
+
+    out << "    {\"kernel\": \"" << r.kernel << "\", \"size\": " << r.size << ", \"elements\": " << r.elements
+	<< ", \"repetitions\": " << r.times.size() << ", \"min\": " << r.minTime() << ", \"mean\": " << r.meanTime()
+	<< ", \"max\": " << r.maxTime() << ", \"minPerElement\": " << r.minTime() / std::max(r.elements, 1) << "}"
+	<< (i + 1 < results.size() ? "," : "") << "\n";
+  }
+
+  out << "  ]\n"
+      << "}\n";
+}
+
+
+int main(int argc, char** argv) try
+{
+  MPIHelper& mpihelper = MPIHelper::instance(argc, argv);
+
+  // Parse parameter file and command line
+  ParameterTree parameterSet;
+  ParameterTreeParser::readINITree("param.ini", parameterSet);
+  ParameterTreeParser::readOptions(argc, argv, parameterSet);
+
+  const std::vector<unsigned> sizes = parameterSet.get<std::vector<unsigned> >("microbenchmark.sizes", std::vector<unsigned>(1, 64));
+  const double refine = parameterSet.get<double>("microbenchmark.refine", 0.1);
+  const int seed = parameterSet.get<int>("microbenchmark.seed", 42);
+  const int repetitions = std::max(parameterSet.get<int>("microbenchmark.repetitions", 5), 1);
+  const std::string prefix = parameterSet.get<std::string>("microbenchmark.prefix", "microbenchmarks");
+
+  std::vector<Result> results;
+
+  for (size_t k = 0; k < sizes.size(); ++k) {
+    const unsigned size = sizes[k];
+
+    // Synthetic grid, distributed by ParMETIS
+    const GlobalVector lower(0), upper(1);
+    std::array<unsigned, dim> n;
+    std::fill(n.begin(), n.end(), size);
+
+    shared_ptr<GridType> grid = StructuredGridFactory<GridType>::createSimplexGrid(lower, upper, n);
+    const GV gv = grid->leafGridView();
+
+    std::vector<unsigned> part(ParMetisGridPartitioner<GV>::initialPartition(gv, mpihelper));
+    grid->loadBalance(part, 0);
+
+    for (InteriorElementIterator eIt = gv.begin<0, Interior_Partition>(); eIt != gv.end<0, Interior_Partition>(); ++eIt)
+      if (random(seed, eIt->geometry().center()) < refine)
+	grid->mark(1, *eIt);
+
+    grid->adapt();
+    grid->postAdapt();
+
+    // Rebalance the refined grid
+    DynamicLoadBalancer<GV> balancer(*grid);
+    balancer.balance();
+
+    int interior = 0;
+    for (InteriorElementIterator eIt = gv.begin<0, Interior_Partition>(); eIt != gv.end<0, Interior_Partition>(); ++eIt)
+      ++interior;
+
+    const int elements = gv.comm().sum(interior);
+
+    if (0 == mpihelper.rank())
+      std::cout << "Size " << size << ": " << elements << " elements on " << mpihelper.size() << " ranks" << std::endl;
+
+    const char* kernels[] = {"globalIndex", "globalIndexLookup", "indexExchange", "buildGraph", "elementPart", "ballMarking", "indicatorMarking",
+			     "haloSetup", "haloCommunicate", "haloPersistent", "haloNeighbor"};
+
+    // The neighbor collectives are last, they need MPI 3
+    const bool neighbor = HaloExchange<GV>::available(HaloExchange<GV>::NeighborCollective);
+    const int numKernels = sizeof(kernels) / sizeof(kernels[0]) - (neighbor ? 0 : 1);
+
+    std::vector<Result> sizeResults(numKernels);
+    for (int j = 0; j < numKernels; ++j) {
+      sizeResults[j].kernel = kernels[j];
+      sizeResults[j].size = size;
+      sizeResults[j].elements = elements;
+    }
+
+    const PartitionConstraints<GV> constraints;
+    std::vector<idx_t> xadj, adjncy, vwgt;
+    std::vector<unsigned> interiorPart(interior, mpihelper.rank());
+
+    // Ball through the middle of the square, so a band of elements is marked
+    GlobalVector center(0.5);
+    const Ball<dim> ball(center, 0.25);
+    const double epsilon = 1. / size;
+    const BallIndicator<dim> indicator(ball, epsilon);
+
+    long lookups = 0;
+
+    // Per-element values, exchanged with every method
+    std::vector<double> u(gv.size(0), 1.);
+
+    HaloExchange<GV> communicateHalo(gv, HaloExchange<GV>::Communicate);
+    HaloExchange<GV> persistentHalo(gv, HaloExchange<GV>::PersistentRequests);
+    shared_ptr<HaloExchange<GV> > neighborHalo;
+    if (neighbor)
+      neighborHalo = shared_ptr<HaloExchange<GV> >(new HaloExchange<GV>(gv, HaloExchange<GV>::NeighborCollective));
+
+    for (int r = 0; r < repetitions; ++r) {
+      double t = start(mpihelper);
+      GlobalUniqueIndex<GV> globalIndex(gv);
+      sizeResults[0].times.push_back(stop(mpihelper, t));
+
+      t = start(mpihelper);
+      for (ElementIterator eIt = gv.begin<0>(); eIt != gv.end<0>(); ++eIt)
+	lookups += globalIndex.findGlobalIndex(*eIt);
+      sizeResults[1].times.push_back(stop(mpihelper, t));
+
+      t = start(mpihelper);
+      globalIndex.exchange();
+      sizeResults[2].times.push_back(stop(mpihelper, t));
+
+      t = start(mpihelper);
+      ParMetisGridPartitioner<GV>::buildGraph(gv, globalIndex, constraints, xadj, adjncy, vwgt);
+      sizeResults[3].times.push_back(stop(mpihelper, t));
+
+      t = start(mpihelper);
+      part = ParMetisGridPartitioner<GV>::elementPart(gv, interiorPart);
+      sizeResults[4].times.push_back(stop(mpihelper, t));
+
+      // Marks only, without adapting, so every repetition sees the same grid
+      t = start(mpihelper);
+      for (InteriorElementIterator eIt = gv.begin<0, Interior_Partition>(); eIt != gv.end<0, Interior_Partition>(); ++eIt)
+	grid->mark(ball.distanceTo(eIt->geometry().center()) < epsilon ? 1 : 0, *eIt);
+      sizeResults[5].times.push_back(stop(mpihelper, t));
+
+      // The same marks from blocks of elements
+      t = start(mpihelper);
+      IndicatorMarking<GridType>::mark(*grid, indicator, 1, true, false);
+      sizeResults[6].times.push_back(stop(mpihelper, t));
+
+      t = start(mpihelper);
+      persistentHalo.update();
+      sizeResults[7].times.push_back(stop(mpihelper, t));
+
+      t = start(mpihelper);
+      communicateHalo.exchange(u);
+      sizeResults[8].times.push_back(stop(mpihelper, t));
+
+      t = start(mpihelper);
+      persistentHalo.exchange(u);
+      sizeResults[9].times.push_back(stop(mpihelper, t));
+
+      if (neighbor) {
+	t = start(mpihelper);
+	neighborHalo->exchange(u);
+	sizeResults[10].times.push_back(stop(mpihelper, t));
+      }
+    }
+
+    // Keep the lookups from being optimized away
+    if (lookups == -1)
+      std::cout << std::endl;
+
+    results.insert(results.end(), sizeResults.begin(), sizeResults.end());
+  }
+
+  if (0 == mpihelper.rank()) {
+    std::ostringstream fileName;
+    fileName << prefix << "_np" << mpihelper.size() << ".json";
+
+    writeJSON(fileName.str(), mpihelper.size(), seed, refine, results);
+
+    for (size_t i = 0; i < results.size(); ++i)
+      std::cout << "   " << results[i].kernel << " " << results[i].size << " " << results[i].minTime() << " s" << std::endl;
+  }
+
+  return 0;
+}
+catch (Exception &e){
+  std::cerr << "Exception: " << e << std::endl;
+  return 1;
+}
@@ -0,0 +1,122 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <dune/common/parallel/mpihelper.hh>
+#include <dune/common/exceptions.hh>
+#include <dune/common/parametertree.hh>
+#include <dune/common/parametertreeparser.hh>
+
+#include <mpi.h>
+
+#include <parmetis.h>
+
+#include <dune/ug_hpc/GraphPartitioner.hh>
+#include <dune/ug_hpc/GraphTrace.hh>
+
+using namespace Dune;
+
+#if PARMETIS_MAJOR_VERSION < 4
+typedef idxtype idx_t;
+typedef float real_t;
+#endif
+
+
+// Replays the dual graphs recorded by dune_ug_hpc with trace.record = true and reports time, edgecut, imbalance
+// and migration of a partitioner on every step, without setting up a grid.  Has to run on as many ranks as the
+// traces were recorded on.  Settings are read from the [replay] section of param.ini and can be overridden on the
+// command line, e.g. -replay.method kway -replay.itr 100.  With replay.method = all, every backend this build
+// supports partitions the same steps.
+
+
+int main(int argc, char** argv) try
+{
+  MPIHelper& mpihelper = MPIHelper::instance(argc, argv);
+
+  // Parse parameter file and command line
+  ParameterTree parameterSet;
+  ParameterTreeParser::readINITree("param.ini", parameterSet);
+  ParameterTreeParser::readOptions(argc, argv, parameterSet);
+
+  const std::string prefix = parameterSet.get<std::string>("replay.prefix", parameterSet.get<std::string>("trace.prefix", "graph"));
+  const size_t steps = parameterSet.get<size_t>("replay.steps", parameterSet.get<size_t>("steps"));
+  const std::string method = parameterSet.get<std::string>("replay.method", "adaptive");
+  const int repetitions = parameterSet.get<int>("replay.repetitions", 1);
+  const std::vector<real_t> tolerances = parameterSet.get<std::vector<real_t> >("replay.tolerances", std::vector<real_t>());
+  const int seed = parameterSet.get<int>("replay.seed", 0);
+
+  const std::vector<GraphPartitioner::Method> methods =
+    (method == "all") ? GraphPartitioner::methods() : std::vector<GraphPartitioner::Method>(1, GraphPartitioner::method(method));
+
+  MPI_Comm comm = MPIHelper::getCommunicator();
+
+  if (0 == mpihelper.rank())
+    std::cout << "step method time edgecut imbalance migration" << std::endl;
+
+  for (size_t s = 0; s < steps; ++s) {
+    const GraphTrace trace = GraphTrace::read(prefix, s, mpihelper.rank());
+
+    if (trace.size != mpihelper.size())
+      DUNE_THROW(Exception, "Trace " << GraphTrace::fileName(prefix, s, mpihelper.rank()) << " was recorded on "
+		 << trace.size << " ranks, replaying on " << mpihelper.size() << ".");
+
+    // Convert the trace to the idx_t ParMETIS was built with
+    GraphPartitioner::Graph graph;
+    graph.vtxdist.assign(trace.vtxdist.begin(), trace.vtxdist.end());
+    graph.xadj.assign(trace.xadj.begin(), trace.xadj.end());
+    graph.adjncy.assign(trace.adjncy.begin(), trace.adjncy.end());
+    graph.vwgt.assign(trace.vwgt.begin(), trace.vwgt.end());
+    graph.ncon = std::max(trace.ncon, 1);
+
+    const std::vector<idx_t> owner(trace.owner.begin(), trace.owner.end());
+
+    // Setup parameters for the partitioners
+    idx_t nparts = mpihelper.size();                                     // number of parts equals number of processes
+    std::vector<real_t> tpwgts(graph.ncon*nparts, 1./nparts);            // same load on every process
+    std::vector<real_t> ubvec(graph.ncon, 1.05);                         // weight tolerance per weight
+    real_t itr = parameterSet.get<real_t>("replay.itr", 1000);           // used by the adaptive and zoltan methods
+
+    for (size_t j = 0; j < tolerances.size() && j < ubvec.size(); ++j)
+      ubvec[j] = tolerances[j];
+
+    for (size_t m = 0; m < methods.size(); ++m) {
+      std::vector<idx_t> part(trace.numVertices());
+      double time = 0;
+
+      for (int k = 0; k < repetitions; ++k) {
+	// RefineKway improves the partition given in part, i.e. the recorded ownership
+	part = owner;
+
+	MPI_Barrier(comm);
+	const double start = MPI_Wtime();
+
+	GraphPartitioner::partition(methods[m], graph, nparts, tpwgts, ubvec, itr, part, comm, seed);
+
+	time += MPI_Wtime() - start;
+      }
+
+      // The slowest rank determines the time of the collective partitioner
+      time /= repetitions;
+      time = mpihelper.getCollectiveCommunication().max(time);
+
+      const GraphPartitioner::Quality quality = GraphPartitioner::evaluate(graph, part, owner, nparts, comm);
+
+      if (0 == mpihelper.rank()) {
+	std::cout << s << " " << GraphPartitioner::name(methods[m]) << " " << time << " " << quality.edgecut << " ";
+	for (size_t j = 0; j < quality.imbalance.size(); ++j)
+	  std::cout << (j > 0 ? "," : "") << quality.imbalance[j];
+	std::cout << " " << quality.migration << std::endl;
+      }
+    }
+  }
+
+  return 0;
+}
+catch (Exception &e){
+  std::cerr << "Exception: " << e << std::endl;
+  return 1;
+}